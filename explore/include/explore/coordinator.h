@@ -0,0 +1,117 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef EXPLORE_COORDINATOR_H_
+#define EXPLORE_COORDINATOR_H_
+
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <ros/ros.h>
+#include <tf/transform_listener.h>
+
+#include <explore/costmap_client.h>
+#include <explore/frontier_allocator.h>
+#include <explore/frontier_search.h>
+
+namespace explore
+{
+/**
+ * @class Coordinator
+ * @brief Searches for frontiers in a map shared by multiple robots and
+ * allocates them to robots
+ * @details Frontiers are searched only once for all robots, search is
+ * repeated only from robots in parts of the map not connected to the first
+ * robot. Each robot gets frontiers ordered by preference on its
+ * `frontier_goals` topic, where they are consumed by Explore running in
+ * coordinated mode.
+ */
+class Coordinator
+{
+public:
+  Coordinator();
+
+private:
+  struct Robot {
+    std::string name;
+    std::string base_frame;
+    ros::Publisher goals_publisher;
+  };
+
+  /**
+   * @brief Searches for frontiers and publishes their allocation
+   */
+  void allocate();
+
+  /**
+   * @brief Reports failed search started from the robot
+   */
+  void logSearchResult(const frontier_exploration::FrontierSearch& search,
+                       const Robot& robot);
+
+  /**
+   * @brief Appends found frontiers not sharing any cell with frontiers
+   * @return true if any frontier was appended
+   */
+  bool addFrontiers(const frontier_exploration::GridView& grid,
+                    const std::vector<frontier_exploration::Frontier>& found,
+                    std::vector<frontier_exploration::Frontier>& frontiers);
+
+  /**
+   * @brief Gets position of the robot in the global frame of the map
+   * @return false if the position is not available
+   */
+  bool robotPosition(const Robot& robot, geometry_msgs::Point& position);
+
+  ros::NodeHandle private_nh_;
+  ros::NodeHandle relative_nh_;
+  tf::TransformListener tf_listener_;
+
+  Costmap2DClient costmap_client_;
+  frontier_exploration::FrontierSearch search_;
+  // searches parts of the map unreachable from the first robot
+  frontier_exploration::FrontierSearch component_search_;
+  frontier_exploration::FrontierAllocator allocator_;
+  std::vector<Robot> robots_;
+  ros::Timer allocation_timer_;
+
+  // parameters
+  double planner_frequency_;
+  double transform_tolerance_;
+};
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef COST_TRANSLATION_H_
+#define COST_TRANSLATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace explore
+{
+/**
+ * @brief Translates occupancy values to costmap costs
+ * @details Values are occupancy probabilities [0..100] or -1 for unknown
+ * cells, as used by nav_msgs::OccupancyGrid. They are mapped to the costs of
+ * costmap_2d. Uses vectorized implementation available on running cpu.
+ *
+ * @param data occupancy values
+ * @param n number of values to translate
+ * @param costs output costs, n cells
+ */
+void translateCosts(const std::int8_t* data, size_t n, unsigned char* costs);
+
+/**
+ * @brief Same as translateCosts, but uses the given implementation
+ * @details Meant for testing implementations against each other.
+ *
+ * @param implementation one of costTranslationImplementations()
+ * @return false if the implementation is not supported, costs are not changed
+ */
+bool translateCosts(const std::string& implementation,
+                    const std::int8_t* data, size_t n, unsigned char* costs);
+
+/**
+ * @brief Name of the implementation used by translateCosts
+ */
+const char* costTranslationImplementation();
+
+/**
+ * @brief Names of implementations supported by running cpu, the one used by
+ * translateCosts first. Scalar implementation is always supported.
+ */
+std::vector<std::string> costTranslationImplementations();
+}
+#endif
@@ -37,6 +37,9 @@
 #ifndef COSTMAP_CLIENT_
 #define COSTMAP_CLIENT_
 
+#include <memory>
+#include <vector>
+
 #include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/Pose.h>
 #include <map_msgs/OccupancyGridUpdate.h>
@@ -47,9 +50,46 @@
 
 namespace explore
 {
+/**
+ * @brief Costmap which can exchange its data with an external buffer
+ */
+class SwappableCostmap : public costmap_2d::Costmap2D
+{
+public:
+  /**
+   * @brief Exchanges costmap data with buffer and sets geometry of the new
+   * data
+   * @details Unlike resizeMap() this does not allocate nor clear any memory.
+   * buffer must hold at least size_x * size_y cells. Caller must hold the
+   * costmap mutex.
+   *
+   * @param buffer new costmap data, will contain the previous data
+   */
+  void swapCharMap(std::unique_ptr<unsigned char[]>& buffer,
+                   unsigned int size_x, unsigned int size_y, double resolution,
+                   double origin_x, double origin_y)
+  {
+    unsigned char* data = buffer.release();
+    buffer.reset(costmap_);
+    costmap_ = data;
+    size_x_ = size_x;
+    size_y_ = size_y;
+    resolution_ = resolution;
+    origin_x_ = origin_x;
+    origin_y_ = origin_y;
+  }
+};
+
 class Costmap2DClient
 {
 public:
+  /**
+   * @brief Rectangular region of the costmap in cells, [x0, xn) x [y0, yn)
+   */
+  struct MapRegion {
+    unsigned int x0, y0, xn, yn;
+  };
+
   /**
    * @brief Contructs client and start listening
    * @details Constructor will block until first map update is received and
@@ -58,7 +98,9 @@ public:
    *
    * @param param_nh node hadle to retrieve parameters from
    * @param subscription_nh node hadle where topics will be subscribed
-   * @param tf_listener Will be used for transformation of robot pose.
+   * @param tf_listener Will be used for transformation of robot pose. May be
+   * null when getRobotPose() is never used, constructor does not wait for
+   * the transformation then.
    */
   Costmap2DClient(ros::NodeHandle& param_nh, ros::NodeHandle& subscription_nh,
                   const tf::TransformListener* tf_listener);
@@ -108,11 +150,30 @@ public:
     return robot_base_frame_;
   }
 
+  /**
+   * @brief Returns regions of the costmap changed since the last call
+   * @details Changed regions are forgotten after the call. Caller should hold
+   * the costmap mutex if the regions need to be consistent with the costmap
+   * data being read.
+   *
+   * @param regions changed regions will be appended here
+   * @return true if the whole costmap has been replaced since the last call.
+   * No regions are reported in that case.
+   */
+  bool takeUpdatedRegions(std::vector<MapRegion>& regions);
+
 protected:
+  // map callbacks are the only writers of the costmap, they must not run
+  // concurrently (i.e. no multi-threaded spinner)
   void updateFullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg);
   void updatePartialMap(const map_msgs::OccupancyGridUpdate::ConstPtr& msg);
+  // records changed region, caller must hold the costmap mutex
+  void addUpdatedRegion(const MapRegion& region);
+  // finds regions of the costmap differing from data of the same geometry
+  void diffRegions(const unsigned char* data,
+                   std::vector<MapRegion>& regions) const;
 
-  costmap_2d::Costmap2D costmap_;
+  SwappableCostmap costmap_;
 
   const tf::TransformListener* const tf_;  ///< @brief Used for transforming
                                            /// point clouds
@@ -120,6 +181,18 @@ protected:
   std::string robot_base_frame_;  ///< @brief The frame_id of the robot base
   double transform_tolerance_;    ///< timeout before transform errors
 
+  // changes since last takeUpdatedRegions(), protected by costmap mutex
+  std::vector<MapRegion> updated_regions_;
+  bool map_replaced_;
+
+  // costs are translated here outside of the costmap lock
+  // costmap data are swapped with staging_, both buffers may have some
+  // spare capacity to accommodate growing maps
+  std::unique_ptr<unsigned char[]> staging_;
+  size_t staging_capacity_;
+  size_t costmap_capacity_;
+  std::vector<unsigned char> partial_staging_;
+
 private:
   // will be unsubscribed at destruction
   ros::Subscriber costmap_sub_;
@@ -0,0 +1,27 @@
+#ifndef COSTMAP_GRID_VIEW_H_
+#define COSTMAP_GRID_VIEW_H_
+
+#include <costmap_2d/costmap_2d.h>
+
+#include <explore/grid_view.h>
+
+namespace frontier_exploration
+{
+/**
+ * @brief View of costmap data for the frontier search
+ * @details The view is valid until the costmap is resized, hold the costmap
+ * mutex while using it.
+ */
+inline GridView costmapGridView(const costmap_2d::Costmap2D& costmap)
+{
+  GridView grid;
+  grid.data = costmap.getCharMap();
+  grid.size_x = costmap.getSizeInCellsX();
+  grid.size_y = costmap.getSizeInCellsY();
+  grid.resolution = costmap.getResolution();
+  grid.origin_x = costmap.getOriginX();
+  grid.origin_y = costmap.getOriginY();
+  return grid;
+}
+}
+#endif
@@ -1,44 +1,93 @@
 #ifndef COSTMAP_TOOLS_H_
 #define COSTMAP_TOOLS_H_
 
-#include <costmap_2d/costmap_2d.h>
-#include <geometry_msgs/PointStamped.h>
-#include <geometry_msgs/PolygonStamped.h>
-#include <ros/ros.h>
+#include <cstddef>
+
+#include <explore/grid_view.h>
+#include <explore/search_buffers.h>
 
 namespace frontier_exploration
 {
+/**
+ * @brief Fixed-capacity list of neighbour cells
+ * @details Lives on stack, so iterating over neighbourhood does not allocate.
+ */
+class NhoodCells
+{
+public:
+  NhoodCells() : size_(0)
+  {
+  }
+
+  void push_back(unsigned int idx)
+  {
+    cells_[size_++] = idx;
+  }
+
+  const unsigned int* begin() const
+  {
+    return cells_;
+  }
+
+  const unsigned int* end() const
+  {
+    return cells_ + size_;
+  }
+
+  size_t size() const
+  {
+    return size_;
+  }
+
+private:
+  unsigned int cells_[8];
+  unsigned int size_;
+};
+
 /**
  * @brief Determine 4-connected neighbourhood of an input cell, checking for map
  * edges
  * @param idx input cell index
- * @param costmap Reference to map data
+ * @param grid Reference to map data
  * @return neighbour cell indexes
  */
-std::vector<unsigned int> nhood4(unsigned int idx,
-                                 const costmap_2d::Costmap2D& costmap)
+inline NhoodCells nhood4(unsigned int idx, const GridView& grid)
 {
   // get 4-connected neighbourhood indexes, check for edge of map
-  std::vector<unsigned int> out;
+  NhoodCells out;
 
-  unsigned int size_x_ = costmap.getSizeInCellsX(),
-               size_y_ = costmap.getSizeInCellsY();
+  unsigned int size_x_ = grid.size_x, size_y_ = grid.size_y;
 
+  // offmap point has no neighbours
   if (idx > size_x_ * size_y_ - 1) {
-    ROS_WARN("Evaluating nhood for offmap point");
     return out;
   }
 
-  if (idx % size_x_ > 0) {
+  unsigned int x = idx % size_x_;
+  bool left = x > 0;
+  bool right = x < size_x_ - 1;
+  bool up = idx >= size_x_;
+  bool down = idx < size_x_ * (size_y_ - 1);
+
+  // interior cells don't need any further checks
+  if (left && right && up && down) {
     out.push_back(idx - 1);
+    out.push_back(idx + 1);
+    out.push_back(idx - size_x_);
+    out.push_back(idx + size_x_);
+    return out;
   }
-  if (idx % size_x_ < size_x_ - 1) {
+
+  if (left) {
+    out.push_back(idx - 1);
+  }
+  if (right) {
     out.push_back(idx + 1);
   }
-  if (idx >= size_x_) {
+  if (up) {
     out.push_back(idx - size_x_);
   }
-  if (idx < size_x_ * (size_y_ - 1)) {
+  if (down) {
     out.push_back(idx + size_x_);
   }
   return out;
@@ -48,35 +97,65 @@ std::vector<unsigned int> nhood4(unsigned int idx,
  * @brief Determine 8-connected neighbourhood of an input cell, checking for map
  * edges
  * @param idx input cell index
- * @param costmap Reference to map data
+ * @param grid Reference to map data
  * @return neighbour cell indexes
  */
-std::vector<unsigned int> nhood8(unsigned int idx,
-                                 const costmap_2d::Costmap2D& costmap)
+inline NhoodCells nhood8(unsigned int idx, const GridView& grid)
 {
   // get 8-connected neighbourhood indexes, check for edge of map
-  std::vector<unsigned int> out = nhood4(idx, costmap);
+  NhoodCells out;
 
-  unsigned int size_x_ = costmap.getSizeInCellsX(),
-               size_y_ = costmap.getSizeInCellsY();
+  unsigned int size_x_ = grid.size_x, size_y_ = grid.size_y;
 
+  // offmap point has no neighbours
   if (idx > size_x_ * size_y_ - 1) {
     return out;
   }
 
-  if (idx % size_x_ > 0 && idx >= size_x_) {
+  unsigned int x = idx % size_x_;
+  bool left = x > 0;
+  bool right = x < size_x_ - 1;
+  bool up = idx >= size_x_;
+  bool down = idx < size_x_ * (size_y_ - 1);
+
+  // interior cells don't need any further checks. 4-connected neighbours go
+  // first, in the same order as for the edge cells.
+  if (left && right && up && down) {
+    out.push_back(idx - 1);
+    out.push_back(idx + 1);
+    out.push_back(idx - size_x_);
+    out.push_back(idx + size_x_);
+    out.push_back(idx - 1 - size_x_);
+    out.push_back(idx - 1 + size_x_);
+    out.push_back(idx + 1 - size_x_);
+    out.push_back(idx + 1 + size_x_);
+    return out;
+  }
+
+  if (left) {
+    out.push_back(idx - 1);
+  }
+  if (right) {
+    out.push_back(idx + 1);
+  }
+  if (up) {
+    out.push_back(idx - size_x_);
+  }
+  if (down) {
+    out.push_back(idx + size_x_);
+  }
+  if (left && up) {
     out.push_back(idx - 1 - size_x_);
   }
-  if (idx % size_x_ > 0 && idx < size_x_ * (size_y_ - 1)) {
+  if (left && down) {
     out.push_back(idx - 1 + size_x_);
   }
-  if (idx % size_x_ < size_x_ - 1 && idx >= size_x_) {
+  if (right && up) {
     out.push_back(idx + 1 - size_x_);
   }
-  if (idx % size_x_ < size_x_ - 1 && idx < size_x_ * (size_y_ - 1)) {
+  if (right && down) {
     out.push_back(idx + 1 + size_x_);
   }
-
   return out;
 }
 
@@ -85,27 +164,29 @@ std::vector<unsigned int> nhood8(unsigned int idx,
  * @param result Index of located cell
  * @param start Index initial cell to search from
  * @param val Specified value to search for
- * @param costmap Reference to map data
+ * @param grid Reference to map data
+ * @param bfs Queue used for the search, allows reusing its buffer
+ * @param visited_flag Flags used for the search, allows reusing its buffer
  * @return True if a cell with the requested value was found
  */
-bool nearestCell(unsigned int& result, unsigned int start, unsigned char val,
-                 const costmap_2d::Costmap2D& costmap)
+inline bool nearestCell(unsigned int& result, unsigned int start,
+                        unsigned char val, const GridView& grid,
+                        CellQueue& bfs, GenerationFlags& visited_flag)
 {
-  const unsigned char* map = costmap.getCharMap();
-  const unsigned int size_x = costmap.getSizeInCellsX(),
-                     size_y = costmap.getSizeInCellsY();
+  const unsigned char* map = grid.data;
+  const unsigned int size_x = grid.size_x, size_y = grid.size_y;
 
   if (start >= size_x * size_y) {
     return false;
   }
 
   // initialize breadth first search
-  std::queue<unsigned int> bfs;
-  std::vector<bool> visited_flag(size_x * size_y, false);
+  bfs.clear();
+  visited_flag.resize(size_x * size_y);
 
   // push initial cell
   bfs.push(start);
-  visited_flag[start] = true;
+  visited_flag.set(start);
 
   // search for neighbouring cell matching value
   while (!bfs.empty()) {
@@ -119,15 +200,31 @@ bool nearestCell(unsigned int& result, unsigned int start, unsigned char val,
     }
 
     // iterate over all adjacent unvisited cells
-    for (unsigned nbr : nhood8(idx, costmap)) {
-      if (!visited_flag[nbr]) {
+    for (unsigned nbr : nhood8(idx, grid)) {
+      if (!visited_flag.test(nbr)) {
         bfs.push(nbr);
-        visited_flag[nbr] = true;
+        visited_flag.set(nbr);
       }
     }
   }
 
   return false;
 }
+
+/**
+ * @brief Find nearest cell of a specified value
+ * @param result Index of located cell
+ * @param start Index initial cell to search from
+ * @param val Specified value to search for
+ * @param grid Reference to map data
+ * @return True if a cell with the requested value was found
+ */
+inline bool nearestCell(unsigned int& result, unsigned int start,
+                        unsigned char val, const GridView& grid)
+{
+  CellQueue bfs;
+  GenerationFlags visited_flag;
+  return nearestCell(result, start, val, grid, bfs, visited_flag);
+}
 }
 #endif
@@ -43,13 +43,17 @@
 #include <vector>
 
 #include <actionlib/client/simple_action_client.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <geometry_msgs/PoseArray.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <move_base_msgs/MoveBaseAction.h>
 #include <ros/ros.h>
-#include <visualization_msgs/MarkerArray.h>
 
 #include <explore/costmap_client.h>
+#include <explore/frontier_blacklist.h>
 #include <explore/frontier_search.h>
+#include <explore/frontier_visualizer.h>
+#include <explore/latency_stats.h>
 
 namespace explore
 {
@@ -74,10 +78,29 @@ private:
   void makePlan();
 
   /**
-   * @brief  Publish a frontiers as markers
+   * @brief Searches for frontiers around the robot
+   * @param pose robot pose in the global frame of the costmap
+   * @param frontiers found frontiers sorted by cost
    */
-  void visualizeFrontiers(
-      const std::vector<frontier_exploration::Frontier>& frontiers);
+  void searchFrontiers(const geometry_msgs::Pose& pose,
+                       std::vector<frontier_exploration::Frontier>& frontiers);
+
+  /**
+   * @brief Gets frontiers allocated to the robot by the coordinator
+   * @param pose robot pose in the global frame of the costmap
+   * @param frontiers allocated frontiers ordered by preference
+   * @return false if no allocation is available yet or the last allocation
+   * is too old
+   */
+  bool
+  assignedFrontiers(const geometry_msgs::Pose& pose,
+                    std::vector<frontier_exploration::Frontier>& frontiers);
+
+  /**
+   * @brief Cancels the current goal until the coordinator allocates frontiers
+   * again
+   */
+  void waitForCoordinator();
 
   void reachedGoal(const actionlib::SimpleClientGoalState& status,
                    const move_base_msgs::MoveBaseResultConstPtr& result,
@@ -85,9 +108,14 @@ private:
 
   bool goalOnBlacklist(const geometry_msgs::Point& goal);
 
+  /**
+   * @brief Publishes latency statistics and counters of planning
+   */
+  void publishDiagnostics();
+
   ros::NodeHandle private_nh_;
   ros::NodeHandle relative_nh_;
-  ros::Publisher marker_array_publisher_;
+  ros::Publisher diagnostics_publisher_;
   tf::TransformListener tf_listener_;
 
   Costmap2DClient costmap_client_;
@@ -96,18 +124,28 @@ private:
   frontier_exploration::FrontierSearch search_;
   ros::Timer exploring_timer_;
   ros::Timer oneshot_;
+  ros::Timer diagnostics_timer_;
+  ros::Subscriber frontier_goals_subscriber_;
+  // last allocation received from the coordinator
+  geometry_msgs::PoseArray::ConstPtr frontier_goals_;
 
-  std::vector<geometry_msgs::Point> frontier_blacklist_;
+  FrontierBlacklist frontier_blacklist_;
   geometry_msgs::Point prev_goal_;
+  // goal was cancelled while waiting for the coordinator
+  bool goal_cancelled_ = false;
   double prev_distance_;
   ros::Time last_progress_;
-  size_t last_markers_count_;
+  std::unique_ptr<FrontierVisualizer> visualizer_;
+  LatencyStats stats_;
 
   // parameters
   double planner_frequency_;
+  double diagnostics_frequency_;
   double potential_scale_, orientation_scale_, gain_scale_;
   ros::Duration progress_timeout_;
   bool visualize_;
+  bool coordinated_;
+  ros::Duration frontier_goals_timeout_;
 };
 }
 
@@ -0,0 +1,93 @@
+#ifndef FRONTIER_ALLOCATOR_H_
+#define FRONTIER_ALLOCATOR_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+
+#include <explore/frontier_search.h>
+#include <explore/grid_view.h>
+#include <explore/search_buffers.h>
+
+namespace frontier_exploration
+{
+/**
+ * @brief Assigns rows to columns minimizing the total cost (Hungarian method)
+ * @details Each row gets at most one column and each column at most one row.
+ * As many rows as possible are assigned. Runs in O(n^2 m) for n = min(rows,
+ * cols), m = max(rows, cols).
+ *
+ * @param costs costs[row][col], all rows must have the same size. Infinite
+ * cost forbids the pair.
+ * @return assigned column for each row, -1 if the row is not assigned
+ */
+std::vector<int> assignMinCost(const std::vector<std::vector<double>>& costs);
+
+/**
+ * @brief Allocates frontiers found by a single search to multiple robots
+ * @details Frontier costs are computed for each robot separately, from the
+ * length of the shortest path from the robot to the frontier and from the
+ * frontier size. Frontiers are then assigned to robots so the total cost is
+ * minimal and no two robots are sent to the same frontier.
+ */
+class FrontierAllocator
+{
+public:
+  FrontierAllocator()
+  {
+  }
+
+  /**
+   * @brief Constructor for allocator
+   * @param potential_scale weight of the path length, the same as in
+   * FrontierSearch
+   * @param gain_scale weight of the frontier size, the same as in
+   * FrontierSearch
+   */
+  FrontierAllocator(double potential_scale, double gain_scale);
+
+  /**
+   * @brief Allocates frontiers to robots
+   * @details Grid must not change during the allocation.
+   *
+   * @param grid grid where the frontiers were found
+   * @param frontiers frontiers to allocate
+   * @param robots positions of robots in world coordinates
+   * @return indexes of frontiers for each robot ordered by preference.
+   * Frontier assigned to the robot is the first, followed by unassigned
+   * frontiers and frontiers assigned to other robots, each ordered by cost
+   * for the robot. Frontiers unreachable by the robot are left out.
+   */
+  std::vector<std::vector<size_t>>
+  allocate(const GridView& grid, const std::vector<Frontier>& frontiers,
+           const std::vector<geometry_msgs::Point>& robots);
+
+protected:
+  /**
+   * @brief Computes lengths of shortest paths from position to frontiers
+   * @details Paths go through free cells and reach frontier through any of
+   * its cells. Frontier cells must be registered in targets_.
+   *
+   * @param position start of paths in world coordinates
+   * @param frontiers number of frontiers
+   * @param distances distance for each frontier in meters, infinity for
+   * unreachable frontiers
+   */
+  void pathDistances(geometry_msgs::Point position, size_t frontiers,
+                     std::vector<double>& distances);
+
+private:
+  GridView grid_;
+  double potential_scale_, gain_scale_;
+  // frontier cell -> index of its frontier
+  std::unordered_map<unsigned int, size_t> targets_;
+  size_t targeted_frontiers_;
+
+  /* buffers reused between allocations */
+  CellQueue bfs_;
+  GenerationFlags visited_;
+  std::vector<unsigned int> distance_;
+};
+}
+#endif
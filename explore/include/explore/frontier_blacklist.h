@@ -0,0 +1,122 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef FRONTIER_BLACKLIST_H_
+#define FRONTIER_BLACKLIST_H_
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+#include <ros/ros.h>
+
+namespace explore
+{
+/**
+ * @brief Set of goals which should not be pursued anymore
+ * @details Goals are hashed to a grid with cells of tolerance size, so lookup
+ * checks only few neighbouring cells regardless of blacklist size.
+ */
+class FrontierBlacklist
+{
+public:
+  /**
+   * @brief Creates empty blacklist
+   *
+   * @param tolerance goals closer than tolerance (in each axis) are considered
+   * the same goal
+   * @param timeout blacklisted goals will be forgotten after this time. Zero
+   * timeout means goals are kept until evicted.
+   * @param max_size maximum number of goals, the oldest goals are evicted
+   * when exceeded. Zero means no limit.
+   */
+  FrontierBlacklist(double tolerance = 0.25,
+                    ros::Duration timeout = ros::Duration(0),
+                    size_t max_size = 1000);
+
+  /**
+   * @brief Changes tolerance, stored goals are rehashed if necessary
+   */
+  void setTolerance(double tolerance);
+
+  /**
+   * @brief Adds goal to blacklist
+   * @details Evicts the oldest goal if the blacklist is full.
+   */
+  void add(const geometry_msgs::Point& goal, const ros::Time& now);
+
+  /**
+   * @brief Tests whether goal is on blacklist
+   * @return true if some blacklisted goal is closer than tolerance
+   */
+  bool contains(const geometry_msgs::Point& goal, const ros::Time& now) const;
+
+  /**
+   * @brief Forgets goals blacklisted longer than timeout
+   */
+  void removeExpired(const ros::Time& now);
+
+  size_t size() const
+  {
+    return entries_.size();
+  }
+
+private:
+  struct Entry {
+    geometry_msgs::Point goal;
+    ros::Time stamp;
+  };
+
+  std::int64_t key(const geometry_msgs::Point& point) const;
+  std::int64_t key(std::int64_t x, std::int64_t y) const;
+  std::int64_t cell(double coordinate) const;
+  bool expired(const Entry& entry, const ros::Time& now) const;
+  void removeOldest();
+
+  double tolerance_;
+  ros::Duration timeout_;
+  size_t max_size_;
+  // entries in order of insertion, i.e. ordered by stamps
+  std::deque<Entry> entries_;
+  // grid hash, grid cell key -> entries in that cell
+  std::unordered_map<std::int64_t, std::vector<Entry>> cells_;
+};
+
+}  // namespace explore
+
+#endif
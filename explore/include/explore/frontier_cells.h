@@ -0,0 +1,50 @@
+#ifndef FRONTIER_CELLS_H_
+#define FRONTIER_CELLS_H_
+
+#include <string>
+#include <vector>
+
+namespace frontier_exploration
+{
+/**
+ * @brief Marks cells which are candidates for frontier cells
+ * @details Frontier cell is an unknown cell with at least one free cell in its
+ * 4-connected neighbourhood. Rows [y0, yn) are processed, for each cell of
+ * these rows mask is set to 1 for frontier cells and 0 otherwise. Uses
+ * vectorized implementation available on running cpu.
+ *
+ * @param map costmap data, size_x * size_y cells
+ * @param size_x width of the map
+ * @param size_y height of the map
+ * @param y0 first row to process
+ * @param yn row after the last row to process
+ * @param mask output mask with the same layout as map
+ */
+void findFrontierCells(const unsigned char* map, unsigned int size_x,
+                       unsigned int size_y, unsigned int y0, unsigned int yn,
+                       unsigned char* mask);
+
+/**
+ * @brief Same as findFrontierCells, but uses the given implementation
+ * @details Meant for testing implementations against each other.
+ *
+ * @param implementation one of frontierCellsImplementations()
+ * @return false if the implementation is not supported, mask is not changed
+ */
+bool findFrontierCells(const std::string& implementation,
+                       const unsigned char* map, unsigned int size_x,
+                       unsigned int size_y, unsigned int y0, unsigned int yn,
+                       unsigned char* mask);
+
+/**
+ * @brief Name of the implementation used by findFrontierCells
+ */
+const char* frontierCellsImplementation();
+
+/**
+ * @brief Names of implementations supported by running cpu, the one used by
+ * findFrontierCells first. Scalar implementation is always supported.
+ */
+std::vector<std::string> frontierCellsImplementations();
+}
+#endif
@@ -1,7 +1,13 @@
 #ifndef FRONTIER_SEARCH_H_
 #define FRONTIER_SEARCH_H_
 
-#include <costmap_2d/costmap_2d.h>
+#include <unordered_map>
+#include <vector>
+
+#include <geometry_msgs/Point.h>
+
+#include <explore/grid_view.h>
+#include <explore/search_buffers.h>
 
 namespace frontier_exploration
 {
@@ -20,8 +26,30 @@ struct Frontier {
 };
 
 /**
- * @brief Thread-safe implementation of a frontier-search task for an input
- * costmap.
+ * @brief Outcome of a search
+ */
+enum class SearchResult {
+  FOUND,          ///< search was done, frontiers may still be empty
+  OUT_OF_BOUNDS,  ///< position is outside of the grid
+  NO_FREE_CELL,   ///< no free cell near position, searched from position
+};
+
+/**
+ * @brief Durations of stages of a search in seconds
+ */
+struct SearchStatistics {
+  double nearest = 0.;  ///< finding the free cell to start from
+  double search = 0.;   ///< growing reachable region and building frontiers
+  double costs = 0.;    ///< computing distances and costs, sorting
+  bool full = false;    ///< whether the whole map was searched
+  SearchResult result = SearchResult::FOUND;  ///< outcome of the search
+};
+
+/**
+ * @brief Implementation of a frontier-search task for an input grid.
+ * @details Search keeps the set of frontiers found during previous searches
+ * and repairs only frontiers crossing regions of the map marked as dirty. The
+ * same instance must not be used for concurrent searches.
  */
 class FrontierSearch
 {
@@ -32,41 +60,101 @@ public:
 
   /**
    * @brief Constructor for search task
-   * @param costmap Reference to costmap data to search.
+   * @param incremental whether to reuse results of previous searches
+   * @param threads number of threads used to build frontiers
+   * @param path_distance whether to measure distance to frontiers along path
+   * found by the search instead of straight line distance
    */
-  FrontierSearch(costmap_2d::Costmap2D* costmap, double potential_scale,
-                 double gain_scale, double min_frontier_size);
+  FrontierSearch(double potential_scale, double gain_scale,
+                 double min_frontier_size, bool incremental,
+                 unsigned int threads, bool path_distance);
 
   /**
    * @brief Runs search implementation, outward from the start position
-   * @param position Initial position to search from
+   * @details Grid must not change during the search. Incremental search
+   * expects the same grid (possibly with different data) in each search,
+   * with its changes marked by markDirty().
+   *
+   * @param grid Grid to search
+   * @param position Initial position to search from, in world coordinates
    * @return List of frontiers, if any
    */
-  std::vector<Frontier> searchFrom(geometry_msgs::Point position);
+  std::vector<Frontier> searchFrom(const GridView& grid,
+                                   geometry_msgs::Point position);
+
+  /**
+   * @brief Marks region of the grid as changed since the last search
+   * @details Frontiers crossing this region will be rebuilt during next
+   * search. Region is in cells, [x0, xn) x [y0, yn).
+   */
+  void markDirty(unsigned int x0, unsigned int y0, unsigned int xn,
+                 unsigned int yn);
+
+  /**
+   * @brief Marks the whole grid as changed, next search will process the
+   * whole map
+   */
+  void markAllDirty();
+
+  /**
+   * @brief Statistics of the last search
+   */
+  const SearchStatistics& lastStatistics() const
+  {
+    return statistics_;
+  }
 
 protected:
   /**
    * @brief Starting from an initial cell, build a frontier from valid adjacent
-   * cells
+   * cells and add it to the set of known frontiers
    * @param initial_cell Index of cell to start frontier building
-   * @param reference Reference index to calculate position from
-   * @param frontier_flag Flag vector indicating which cells are already marked
-   * as frontiers
-   * @return new frontier
    */
-  Frontier buildNewFrontier(unsigned int initial_cell, unsigned int reference,
-                            std::vector<bool>& frontier_flag);
+  void buildNewFrontier(unsigned int initial_cell);
 
   /**
    * @brief isNewFrontierCell Evaluate if candidate cell is a valid candidate
    * for a new frontier.
    * @param idx Index of candidate cell
-   * @param frontier_flag Flag vector indicating which cells are already marked
-   * as frontiers
    * @return true if the cell is frontier cell
    */
-  bool isNewFrontierCell(unsigned int idx,
-                         const std::vector<bool>& frontier_flag);
+  bool isNewFrontierCell(unsigned int idx);
+
+  /**
+   * @brief Expands region reachable from the robot, building frontiers
+   * adjacent to the newly reached cells
+   * @details Expands from reached cells in bfs_ queue.
+   * @param build_frontiers whether to build adjacent frontiers
+   */
+  void expandReachable(bool build_frontiers);
+
+  /**
+   * @brief Discards all previous results and searches the whole map
+   * @param start Index of cell to start search from
+   */
+  void searchFull(unsigned int start);
+
+  /**
+   * @brief Builds all frontiers adjacent to the reachable region using
+   * multiple threads
+   * @details Map is split into bands labeled in parallel, frontiers crossing
+   * bands are joined afterwards.
+   */
+  void buildFrontiersParallel();
+
+  /**
+   * @brief Computes lengths of shortest paths from start through the
+   * reachable region
+   * @param start Index of cell to measure distance from
+   */
+  void computePathDistances(unsigned int start);
+
+  /**
+   * @brief Rebuilds frontiers crossing dirty regions
+   * @return false if the reachable region has shrunk and the incremental
+   * repair is not possible
+   */
+  bool repairDirty();
 
   /**
    * @brief computes frontier cost
@@ -78,11 +166,61 @@ protected:
   double frontierCost(const Frontier& frontier);
 
 private:
-  costmap_2d::Costmap2D* costmap_;
-  unsigned char* map_;
+  struct Region {
+    unsigned int x0, y0, xn, yn;
+  };
+
+  struct Cluster {
+    Frontier frontier;
+    // all cells of the frontier, including the initial cell
+    std::vector<unsigned int> cells;
+  };
+
+  // removes frontier from the set of known frontiers, its cells are appended
+  // to released
+  void removeFrontier(size_t id, std::vector<unsigned int>& released);
+  // computes distance of the frontier to the reference cell
+  void updateDistance(Frontier& frontier,
+                      const std::vector<unsigned int>& cells,
+                      unsigned int reference);
+
+  // grid of the current search
+  GridView grid_;
+  const unsigned char* map_;
   unsigned int size_x_, size_y_;
   double potential_scale_, gain_scale_;
   double min_frontier_size_;
+  bool incremental_;
+  unsigned int threads_;
+  bool path_distance_;
+
+  /* state kept between searches */
+  // map regions changed since last search
+  std::vector<Region> dirty_regions_;
+  bool all_dirty_ = true;
+  // flags of cells reached by the breadth first search from the robot
+  std::vector<bool> reachable_flag_;
+  // reachable region consists only of free cells
+  bool reachable_free_ = false;
+  // flags of cells which are part of some frontier
+  std::vector<bool> frontier_flag_;
+  // mask of frontier cells, i.e. unknown cells with free neighbour
+  std::vector<unsigned char> frontier_cells_;
+  // known frontiers, empty cells mark unused slots
+  std::vector<Cluster> clusters_;
+  std::vector<size_t> free_clusters_;
+  // maps frontier cells to frontiers in clusters_
+  std::unordered_map<unsigned int, size_t> cell_cluster_;
+  // lengths of paths from the robot in cells, valid where path_visited_ is set
+  std::vector<unsigned int> distance_;
+  GenerationFlags path_visited_;
+  SearchStatistics statistics_;
+
+  /* scratch buffers reused between searches */
+  CellQueue bfs_;
+  CellQueue frontier_bfs_;
+  GenerationFlags nearest_visited_;
+  std::vector<unsigned int> released_;
 };
 }
 #endif
@@ -0,0 +1,132 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+#ifndef FRONTIER_VISUALIZER_H_
+#define FRONTIER_VISUALIZER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ros/ros.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include <explore/frontier_search.h>
+
+namespace explore
+{
+/**
+ * @brief Publishes frontiers as visualization markers
+ * @details Markers are built and published by a low priority worker thread.
+ * Each frontier keeps its marker ids while it stays the same, only markers of
+ * added, changed and removed frontiers are published. Frontier points are
+ * decimated to a fixed budget per frontier.
+ */
+class FrontierVisualizer
+{
+public:
+  /**
+   * @brief Advertises topic and starts worker thread
+   *
+   * @param nh node handle to advertise topic on
+   * @param topic topic for visualization_msgs/MarkerArray messages
+   * @param max_points maximum number of points of one frontier to publish,
+   * 0 publishes all points
+   */
+  FrontierVisualizer(ros::NodeHandle& nh, const std::string& topic,
+                     size_t max_points);
+  ~FrontierVisualizer();
+
+  /**
+   * @brief Schedules frontiers for publishing
+   * @details Returns immediately. Frontiers scheduled earlier and not yet
+   * processed by the worker are dropped.
+   *
+   * @param frontiers frontiers sorted by cost
+   * @param blacklisted whether the goal of each frontier is blacklisted
+   * @param frame_id frame of the frontiers
+   */
+  void publish(std::vector<frontier_exploration::Frontier>&& frontiers,
+               std::vector<bool>&& blacklisted, const std::string& frame_id);
+
+private:
+  struct Job {
+    std::vector<frontier_exploration::Frontier> frontiers;
+    std::vector<bool> blacklisted;
+    std::string frame_id;
+  };
+
+  // state of a published frontier
+  struct Shown {
+    int id;  // markers 2 * id and 2 * id + 1 belong to the frontier
+    std::uint32_t size;
+    geometry_msgs::Point centroid;
+    bool blacklisted;
+    double scale;
+    bool seen;
+  };
+
+  // frontiers are identified by their initial cell, in mm
+  typedef std::pair<long long, long long> Key;
+
+  void run();
+  void buildMarkers(const Job& job, visualization_msgs::MarkerArray& msg);
+
+  ros::Publisher publisher_;
+  size_t max_points_;
+
+  // pending job, protected by mutex_
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  Job pending_;
+  bool has_pending_;
+  bool refresh_;  // new subscriber needs all markers
+  bool shutdown_;
+
+  // owned by the worker
+  std::map<Key, Shown> shown_;
+  std::vector<int> free_ids_;
+  int next_id_;
+
+  std::thread worker_;
+};
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef GRID_VIEW_H_
+#define GRID_VIEW_H_
+
+namespace frontier_exploration
+{
+/* cost values used by the search, the same as in costmap_2d */
+constexpr unsigned char NO_INFORMATION = 255;
+constexpr unsigned char LETHAL_OBSTACLE = 254;
+constexpr unsigned char FREE_SPACE = 0;
+
+/**
+ * @brief Non-owning view of a grid searched for frontiers
+ * @details Cells are stored row by row starting at origin, with the same
+ * cost values and coordinate conventions as costmap_2d::Costmap2D. Does not
+ * depend on ROS, so the search can be run on maps loaded from anywhere.
+ */
+struct GridView {
+  const unsigned char* data = nullptr;
+  unsigned int size_x = 0;
+  unsigned int size_y = 0;
+  double resolution = 0.;
+  double origin_x = 0.;
+  double origin_y = 0.;
+
+  unsigned int getIndex(unsigned int mx, unsigned int my) const
+  {
+    return my * size_x + mx;
+  }
+
+  void indexToCells(unsigned int index, unsigned int& mx,
+                    unsigned int& my) const
+  {
+    my = index / size_x;
+    mx = index - my * size_x;
+  }
+
+  /**
+   * @brief Converts world coordinates to cell coordinates
+   * @return false if the point is outside of the grid
+   */
+  bool worldToMap(double wx, double wy, unsigned int& mx,
+                  unsigned int& my) const
+  {
+    if (wx < origin_x || wy < origin_y) {
+      return false;
+    }
+    mx = static_cast<unsigned int>((wx - origin_x) / resolution);
+    my = static_cast<unsigned int>((wy - origin_y) / resolution);
+    return mx < size_x && my < size_y;
+  }
+
+  /**
+   * @brief Converts cell coordinates to world coordinates of the cell centre
+   */
+  void mapToWorld(unsigned int mx, unsigned int my, double& wx,
+                  double& wy) const
+  {
+    wx = origin_x + (mx + 0.5) * resolution;
+    wy = origin_y + (my + 0.5) * resolution;
+  }
+};
+}
+#endif
@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef LATENCY_STATS_H_
+#define LATENCY_STATS_H_
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace explore
+{
+/**
+ * @brief Rolling latency statistics of named stages and aggregated counters
+ * @details Each stage keeps last window samples, percentiles are computed
+ * from these samples on request. Not thread-safe.
+ */
+class LatencyStats
+{
+public:
+  /**
+   * @brief Summary of latencies of one stage over the rolling window
+   */
+  struct Summary {
+    size_t samples;  ///< number of samples in the window
+    double last, p50, p95, p99, max;  ///< in seconds
+  };
+
+  /**
+   * @param window number of samples kept for each stage
+   */
+  explicit LatencyStats(size_t window = 256);
+
+  /**
+   * @brief Records duration of a stage
+   *
+   * @param stage name of the stage
+   * @param seconds duration of the stage
+   */
+  void add(const std::string& stage, double seconds);
+
+  /**
+   * @brief Increments counter
+   */
+  void count(const std::string& counter, size_t n = 1);
+
+  /**
+   * @brief Summaries of all recorded stages by stage name
+   */
+  std::map<std::string, Summary> summaries() const;
+
+  /**
+   * @brief Values of all counters by counter name
+   */
+  const std::map<std::string, size_t>& counters() const
+  {
+    return counters_;
+  }
+
+private:
+  struct Window {
+    std::vector<double> samples;
+    size_t next = 0;
+    double last = 0.;
+  };
+
+  size_t window_;
+  std::map<std::string, Window> stages_;
+  std::map<std::string, size_t> counters_;
+};
+
+/**
+ * @brief Measures duration of the enclosing scope and records it as a stage
+ */
+class ScopedTimer
+{
+public:
+  ScopedTimer(LatencyStats& stats, const char* stage)
+    : stats_(stats), stage_(stage), start_(std::chrono::steady_clock::now())
+  {
+  }
+
+  ~ScopedTimer()
+  {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    stats_.add(stage_, elapsed.count());
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  LatencyStats& stats_;
+  const char* stage_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace explore
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef SEARCH_BUFFERS_H_
+#define SEARCH_BUFFERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace frontier_exploration
+{
+/**
+ * @brief FIFO queue of cell indexes for breadth first searches
+ * @details Cells are stored in a ring buffer, which keeps its capacity between
+ * searches, so a search does not allocate once the buffer is large enough.
+ */
+class CellQueue
+{
+public:
+  CellQueue() : head_(0), size_(0)
+  {
+  }
+
+  /**
+   * @brief Ensures capacity for at least capacity cells
+   */
+  void reserve(size_t capacity)
+  {
+    if (capacity > buffer_.size()) {
+      grow(capacity);
+    }
+  }
+
+  void push(unsigned int idx)
+  {
+    if (size_ == buffer_.size()) {
+      grow(buffer_.empty() ? 64 : 2 * buffer_.size());
+    }
+    size_t tail = head_ + size_;
+    if (tail >= buffer_.size()) {
+      tail -= buffer_.size();
+    }
+    buffer_[tail] = idx;
+    ++size_;
+  }
+
+  unsigned int front() const
+  {
+    return buffer_[head_];
+  }
+
+  void pop()
+  {
+    ++head_;
+    if (head_ == buffer_.size()) {
+      head_ = 0;
+    }
+    --size_;
+  }
+
+  bool empty() const
+  {
+    return size_ == 0;
+  }
+
+  void clear()
+  {
+    head_ = 0;
+    size_ = 0;
+  }
+
+private:
+  void grow(size_t capacity)
+  {
+    // unroll queue to the beginning of the new buffer
+    std::vector<unsigned int> buffer(capacity);
+    for (size_t i = 0; i < size_; ++i) {
+      size_t j = head_ + i;
+      buffer[i] = buffer_[j < buffer_.size() ? j : j - buffer_.size()];
+    }
+    buffer_.swap(buffer);
+    head_ = 0;
+  }
+
+  std::vector<unsigned int> buffer_;
+  size_t head_;
+  size_t size_;
+};
+
+/**
+ * @brief Flags of cells visited by a search, which can be cleared in constant
+ * time
+ * @details Each cell stores generation of the search which visited it.
+ * Clearing starts a new generation, whole array is zeroed only when the
+ * generation counter wraps around.
+ */
+class GenerationFlags
+{
+public:
+  GenerationFlags() : generation_(1)
+  {
+  }
+
+  /**
+   * @brief Resizes flags to size cells and clears all flags
+   * @details Memory is reallocated only when the size changes.
+   */
+  void resize(size_t size)
+  {
+    if (size != stamps_.size()) {
+      stamps_.assign(size, 0);
+      generation_ = 1;
+    } else {
+      clear();
+    }
+  }
+
+  void clear()
+  {
+    ++generation_;
+    if (generation_ == 0) {
+      stamps_.assign(stamps_.size(), 0);
+      generation_ = 1;
+    }
+  }
+
+  bool test(unsigned int idx) const
+  {
+    return stamps_[idx] == generation_;
+  }
+
+  void set(unsigned int idx)
+  {
+    stamps_[idx] = generation_;
+  }
+
+  size_t size() const
+  {
+    return stamps_.size();
+  }
+
+private:
+  std::vector<std::uint8_t> stamps_;
+  std::uint8_t generation_;
+};
+}
+#endif
@@ -0,0 +1,256 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/coordinator.h>
+
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <geometry_msgs/PoseArray.h>
+
+#include <explore/costmap_grid_view.h>
+
+namespace explore
+{
+Coordinator::Coordinator()
+  : private_nh_("~")
+  , tf_listener_(ros::Duration(10.0))
+  // robot positions are looked up by the coordinator itself
+  , costmap_client_(private_nh_, relative_nh_, nullptr)
+{
+  std::vector<std::string> robot_names;
+  std::string robot_base_frame;
+  double potential_scale, gain_scale;
+  double min_frontier_size;
+  bool incremental_search;
+  int search_threads;
+  private_nh_.param("robots", robot_names, std::vector<std::string>());
+  private_nh_.param("robot_base_frame", robot_base_frame,
+                    std::string("base_link"));
+  private_nh_.param("planner_frequency", planner_frequency_, 1.0);
+  private_nh_.param("transform_tolerance", transform_tolerance_, 0.3);
+  private_nh_.param("potential_scale", potential_scale, 1e-3);
+  private_nh_.param("gain_scale", gain_scale, 1.0);
+  private_nh_.param("min_frontier_size", min_frontier_size, 0.5);
+  private_nh_.param("incremental_search", incremental_search, true);
+  private_nh_.param("search_threads", search_threads, 1);
+  if (search_threads <= 0) {
+    search_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+
+  // allocation computes path distances for every robot itself
+  search_ = frontier_exploration::FrontierSearch(
+      potential_scale, gain_scale, min_frontier_size, incremental_search,
+      static_cast<unsigned int>(search_threads), false);
+  // searches of other parts of the map start from different robots, there is
+  // nothing to reuse
+  component_search_ = frontier_exploration::FrontierSearch(
+      potential_scale, gain_scale, min_frontier_size, false,
+      static_cast<unsigned int>(search_threads), false);
+  allocator_ =
+      frontier_exploration::FrontierAllocator(potential_scale, gain_scale);
+
+  if (robot_names.empty()) {
+    ROS_ERROR("No robots to coordinate, set ~robots parameter");
+  }
+  for (const auto& name : robot_names) {
+    Robot robot;
+    robot.name = name;
+    robot.base_frame = tf::resolve(name, robot_base_frame);
+    robot.goals_publisher = relative_nh_.advertise<geometry_msgs::PoseArray>(
+        ros::names::append(name, "frontier_goals"), 1, true);
+    ROS_INFO("coordinating robot %s, base frame %s", name.c_str(),
+             robot.base_frame.c_str());
+    robots_.push_back(robot);
+  }
+
+  allocation_timer_ =
+      relative_nh_.createTimer(ros::Duration(1. / planner_frequency_),
+                               [this](const ros::TimerEvent&) { allocate(); });
+}
+
+void Coordinator::logSearchResult(
+    const frontier_exploration::FrontierSearch& search, const Robot& robot)
+{
+  if (search.lastStatistics().result ==
+      frontier_exploration::SearchResult::OUT_OF_BOUNDS) {
+    ROS_ERROR_THROTTLE(1.0, "Robot %s out of map bounds, cannot search for "
+                            "frontiers",
+                       robot.name.c_str());
+  }
+}
+
+bool Coordinator::addFrontiers(
+    const frontier_exploration::GridView& grid,
+    const std::vector<frontier_exploration::Frontier>& found,
+    std::vector<frontier_exploration::Frontier>& frontiers)
+{
+  // frontier bordering two parts of the map is found from both of them
+  std::unordered_set<unsigned int> known_cells;
+  for (const auto& frontier : frontiers) {
+    for (const auto& point : frontier.points) {
+      unsigned int mx, my;
+      if (grid.worldToMap(point.x, point.y, mx, my)) {
+        known_cells.insert(grid.getIndex(mx, my));
+      }
+    }
+  }
+
+  bool added = false;
+  for (const auto& frontier : found) {
+    bool known = false;
+    for (const auto& point : frontier.points) {
+      unsigned int mx, my;
+      if (grid.worldToMap(point.x, point.y, mx, my) &&
+          known_cells.count(grid.getIndex(mx, my))) {
+        known = true;
+        break;
+      }
+    }
+    if (!known) {
+      frontiers.push_back(frontier);
+      added = true;
+    }
+  }
+  return added;
+}
+
+bool Coordinator::robotPosition(const Robot& robot,
+                                geometry_msgs::Point& position)
+{
+  tf::StampedTransform transform;
+  try {
+    tf_listener_.lookupTransform(costmap_client_.getGlobalFrameID(),
+                                 robot.base_frame, ros::Time(), transform);
+  } catch (tf::TransformException& ex) {
+    ROS_WARN_THROTTLE(1.0, "Could not get position of robot %s: %s",
+                      robot.name.c_str(), ex.what());
+    return false;
+  }
+  if ((ros::Time::now() - transform.stamp_).toSec() > transform_tolerance_) {
+    ROS_WARN_THROTTLE(1.0, "Position of robot %s is too old: %.4f s",
+                      robot.name.c_str(),
+                      (ros::Time::now() - transform.stamp_).toSec());
+    return false;
+  }
+  tf::pointTFToMsg(transform.getOrigin(), position);
+  return true;
+}
+
+void Coordinator::allocate()
+{
+  geometry_msgs::PoseArray msg;
+  msg.header.frame_id = costmap_client_.getGlobalFrameID();
+  msg.header.stamp = ros::Time::now();
+
+  // robots without known position get no frontiers this time. They must not
+  // keep the last allocation, its frontiers may be allocated to other robots
+  // now.
+  std::vector<const Robot*> located;
+  std::vector<geometry_msgs::Point> positions;
+  for (const auto& robot : robots_) {
+    geometry_msgs::Point position;
+    if (robotPosition(robot, position)) {
+      located.push_back(&robot);
+      positions.push_back(position);
+    } else {
+      robot.goals_publisher.publish(msg);
+    }
+  }
+  if (located.empty()) {
+    return;
+  }
+
+  std::vector<frontier_exploration::Frontier> frontiers;
+  std::vector<std::vector<size_t>> allocation;
+  {
+    // hold the lock, so no map update happens during the search and the
+    // allocation
+    std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(
+        *costmap_client_.getCostmap()->getMutex());
+    std::vector<Costmap2DClient::MapRegion> regions;
+    if (costmap_client_.takeUpdatedRegions(regions)) {
+      search_.markAllDirty();
+    }
+    for (const auto& region : regions) {
+      search_.markDirty(region.x0, region.y0, region.xn, region.yn);
+    }
+    frontier_exploration::GridView grid =
+        frontier_exploration::costmapGridView(*costmap_client_.getCostmap());
+    // one search for all robots, from the first located robot
+    frontiers = search_.searchFrom(grid, positions.front());
+    logSearchResult(search_, *located.front());
+    allocation = allocator_.allocate(grid, frontiers, positions);
+    // robots in parts of the map not connected to the first robot can't
+    // reach any of its frontiers, search again from them
+    for (size_t r = 1; r < located.size(); ++r) {
+      if (!allocation[r].empty()) {
+        continue;
+      }
+      std::vector<frontier_exploration::Frontier> found =
+          component_search_.searchFrom(grid, positions[r]);
+      logSearchResult(component_search_, *located[r]);
+      if (addFrontiers(grid, found, frontiers)) {
+        allocation = allocator_.allocate(grid, frontiers, positions);
+      }
+    }
+  }
+  ROS_DEBUG("allocating %lu frontiers to %lu robots", frontiers.size(),
+            located.size());
+
+  for (size_t r = 0; r < located.size(); ++r) {
+    msg.poses.clear();
+    for (size_t i : allocation[r]) {
+      geometry_msgs::Pose pose;
+      pose.position = frontiers[i].centroid;
+      pose.orientation.w = 1.;
+      msg.poses.push_back(pose);
+    }
+    located[r]->goals_publisher.publish(msg);
+  }
+}
+
+}  // namespace explore
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "explore_coordinator");
+  explore::Coordinator coordinator;
+  ros::spin();
+
+  return 0;
+}
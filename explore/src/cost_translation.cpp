@@ -0,0 +1,256 @@
+#include <explore/cost_translation.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COST_TRANSLATION_X86
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define COST_TRANSLATION_NEON
+#include <arm_neon.h>
+#endif
+
+namespace explore
+{
+namespace
+{
+/* Kernels translate as many values as fits to whole vectors and return
+ * number of translated values. */
+typedef size_t (*Kernel)(const unsigned char* data, size_t n,
+                         unsigned char* costs);
+
+std::array<unsigned char, 256> initTranslationTable()
+{
+  std::array<unsigned char, 256> cost_translation_table;
+
+  // lineary mapped from [0..100] to [0..255]
+  for (size_t i = 0; i < 256; ++i) {
+    cost_translation_table[i] =
+        static_cast<unsigned char>(1 + (251 * (i - 1)) / 97);
+  }
+
+  // special values:
+  cost_translation_table[0] = 0;      // NO obstacle
+  cost_translation_table[99] = 253;   // INSCRIBED obstacle
+  cost_translation_table[100] = 254;  // LETHAL obstacle
+  cost_translation_table[static_cast<unsigned char>(-1)] = 255;  // UNKNOWN
+
+  return cost_translation_table;
+}
+
+// static translation table to speed things up
+const std::array<unsigned char, 256>& translationTable()
+{
+  static const std::array<unsigned char, 256> table = initTranslationTable();
+  return table;
+}
+
+void translateScalar(const unsigned char* data, size_t n, unsigned char* costs)
+{
+  const std::array<unsigned char, 256>& table = translationTable();
+  for (size_t i = 0; i < n; ++i) {
+    costs[i] = table[data[i]];
+  }
+}
+
+size_t kernelScalar(const unsigned char*, size_t, unsigned char*)
+{
+  return 0;
+}
+
+#ifdef COST_TRANSLATION_X86
+/* x86 kernels compute the linear mapping 1 + 251 * (v - 1) / 97 in 16-bit
+ * lanes, division is done by multiplication with 2^22 / 97, which is exact
+ * for all values in [1..98]. Saturating subtraction maps value 0 to cost 0.
+ * Obstacles 99, 100 and unknown 255 are all mapped to v + 154 (saturated).
+ * Values outside of the occupancy range are not expected in valid maps,
+ * vectors containing them are translated by the table. */
+__attribute__((target("sse2"))) __m128i quotientSSE2(__m128i words)
+{
+  __m128i scaled = _mm_mullo_epi16(_mm_subs_epu16(words, _mm_set1_epi16(1)),
+                                   _mm_set1_epi16(251));
+  return _mm_srli_epi16(_mm_mulhi_epu16(scaled, _mm_set1_epi16(-22295)), 6);
+}
+
+__attribute__((target("sse2"))) size_t kernelSSE2(const unsigned char* data,
+                                                  size_t n,
+                                                  unsigned char* costs)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i first_obstacle = _mm_set1_epi8(99);
+  const __m128i first_invalid = _mm_set1_epi8(101);
+  const __m128i unknown = _mm_set1_epi8(char(255));
+  const __m128i obstacle_offset = _mm_set1_epi8(char(154));
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i invalid =
+        _mm_andnot_si128(_mm_cmpeq_epi8(v, unknown),
+                         _mm_cmpeq_epi8(_mm_max_epu8(v, first_invalid), v));
+    if (_mm_movemask_epi8(invalid)) {
+      translateScalar(data + i, 16, costs + i);
+      continue;
+    }
+    __m128i linear =
+        _mm_add_epi8(_mm_packus_epi16(quotientSSE2(_mm_unpacklo_epi8(v, zero)),
+                                      quotientSSE2(_mm_unpackhi_epi8(v, zero))),
+                     _mm_min_epu8(v, one));
+    __m128i obstacle = _mm_cmpeq_epi8(_mm_max_epu8(v, first_obstacle), v);
+    __m128i c = _mm_or_si128(
+        _mm_andnot_si128(obstacle, linear),
+        _mm_and_si128(obstacle, _mm_adds_epu8(v, obstacle_offset)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(costs + i), c);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) __m256i quotientAVX2(__m256i words)
+{
+  __m256i scaled = _mm256_mullo_epi16(
+      _mm256_subs_epu16(words, _mm256_set1_epi16(1)), _mm256_set1_epi16(251));
+  return _mm256_srli_epi16(
+      _mm256_mulhi_epu16(scaled, _mm256_set1_epi16(-22295)), 6);
+}
+
+__attribute__((target("avx2"))) size_t kernelAVX2(const unsigned char* data,
+                                                  size_t n,
+                                                  unsigned char* costs)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i first_obstacle = _mm256_set1_epi8(99);
+  const __m256i first_invalid = _mm256_set1_epi8(101);
+  const __m256i unknown = _mm256_set1_epi8(char(255));
+  const __m256i obstacle_offset = _mm256_set1_epi8(char(154));
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i invalid = _mm256_andnot_si256(
+        _mm256_cmpeq_epi8(v, unknown),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(v, first_invalid), v));
+    if (_mm256_movemask_epi8(invalid)) {
+      translateScalar(data + i, 32, costs + i);
+      continue;
+    }
+    // unpack and pack work within 128-bit lanes, so the order is preserved
+    __m256i linear = _mm256_add_epi8(
+        _mm256_packus_epi16(quotientAVX2(_mm256_unpacklo_epi8(v, zero)),
+                            quotientAVX2(_mm256_unpackhi_epi8(v, zero))),
+        _mm256_min_epu8(v, one));
+    __m256i obstacle =
+        _mm256_cmpeq_epi8(_mm256_max_epu8(v, first_obstacle), v);
+    __m256i c = _mm256_blendv_epi8(
+        linear, _mm256_adds_epu8(v, obstacle_offset), obstacle);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(costs + i), c);
+  }
+  // finish with narrower vectors
+  return i + kernelSSE2(data + i, n - i, costs + i);
+}
+#endif
+
+#ifdef COST_TRANSLATION_NEON
+/* NEON can look up whole table directly, in 4 blocks of 64 entries. Lookups
+ * out of the block range keep the previous result. */
+size_t kernelNEON(const unsigned char* data, size_t n, unsigned char* costs)
+{
+  const unsigned char* table = translationTable().data();
+  uint8x16x4_t blocks[4];
+  for (size_t b = 0; b < 4; ++b) {
+    for (size_t j = 0; j < 4; ++j) {
+      blocks[b].val[j] = vld1q_u8(table + 64 * b + 16 * j);
+    }
+  }
+  const uint8x16_t block_size = vdupq_n_u8(64);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t idx = vld1q_u8(data + i);
+    uint8x16_t c = vqtbl4q_u8(blocks[0], idx);
+    idx = vsubq_u8(idx, block_size);
+    c = vqtbx4q_u8(c, blocks[1], idx);
+    idx = vsubq_u8(idx, block_size);
+    c = vqtbx4q_u8(c, blocks[2], idx);
+    idx = vsubq_u8(idx, block_size);
+    c = vqtbx4q_u8(c, blocks[3], idx);
+    vst1q_u8(costs + i, c);
+  }
+  return i;
+}
+#endif
+
+struct Implementation {
+  Kernel kernel;
+  const char* name;
+};
+
+std::vector<Implementation> supportedImplementations()
+{
+  std::vector<Implementation> supported;
+#ifdef COST_TRANSLATION_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    supported.push_back({kernelAVX2, "avx2"});
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    supported.push_back({kernelSSE2, "sse2"});
+  }
+#endif
+#ifdef COST_TRANSLATION_NEON
+  supported.push_back({kernelNEON, "neon"});
+#endif
+  supported.push_back({kernelScalar, "scalar"});
+  return supported;
+}
+
+// supported implementations, the fastest first
+const std::vector<Implementation>& implementations()
+{
+  // detected once, initialization is thread-safe
+  static const std::vector<Implementation> supported =
+      supportedImplementations();
+  return supported;
+}
+
+void translate(Kernel kernel, const std::int8_t* data, size_t n,
+               unsigned char* costs)
+{
+  const unsigned char* values = reinterpret_cast<const unsigned char*>(data);
+  size_t done = kernel(values, n, costs);
+  translateScalar(values + done, n - done, costs + done);
+}
+}  // namespace
+
+void translateCosts(const std::int8_t* data, size_t n, unsigned char* costs)
+{
+  translate(implementations().front().kernel, data, n, costs);
+}
+
+bool translateCosts(const std::string& implementation,
+                    const std::int8_t* data, size_t n, unsigned char* costs)
+{
+  for (const auto& impl : implementations()) {
+    if (implementation == impl.name) {
+      translate(impl.kernel, data, n, costs);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> costTranslationImplementations()
+{
+  std::vector<std::string> names;
+  for (const auto& impl : implementations()) {
+    names.push_back(impl.name);
+  }
+  return names;
+}
+
+const char* costTranslationImplementation()
+{
+  return implementations().front().name;
+}
+}
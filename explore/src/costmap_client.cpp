@@ -36,21 +36,22 @@
 
 #include <explore/costmap_client.h>
 
+#include <algorithm>
 #include <functional>
 #include <mutex>
 #include <string>
 
+#include <explore/cost_translation.h>
+
 namespace explore
 {
-// static translation table to speed things up
-std::array<unsigned char, 256> init_translation_table();
-static const std::array<unsigned char, 256> cost_translation_table__ =
-    init_translation_table();
-
 Costmap2DClient::Costmap2DClient(ros::NodeHandle& param_nh,
                                  ros::NodeHandle& subscription_nh,
                                  const tf::TransformListener* tf)
   : tf_(tf)
+  , map_replaced_(true)
+  , staging_capacity_(0)
+  , costmap_capacity_(0)
 {
   std::string costmap_topic;
   std::string footprint_topic;
@@ -92,7 +93,7 @@ Costmap2DClient::Costmap2DClient(ros::NodeHandle& param_nh,
   /* tf transform is necessary for getRobotPose */
   ros::Time last_error = ros::Time::now();
   std::string tf_error;
-  while (ros::ok() &&
+  while (tf_ && ros::ok() &&
          !tf_->waitForTransform(global_frame_, robot_base_frame_, ros::Time(),
                                 ros::Duration(0.1), ros::Duration(0.01),
                                 &tf_error)) {
@@ -122,24 +123,98 @@ void Costmap2DClient::updateFullMap(const nav_msgs::OccupancyGrid::ConstPtr& msg
   double origin_x = msg->info.origin.position.x;
   double origin_y = msg->info.origin.position.y;
 
-  ROS_DEBUG("received full new map, resizing to: %d, %d", size_in_cells_x,
-            size_in_cells_y);
-  costmap_.resizeMap(size_in_cells_x, size_in_cells_y, resolution, origin_x,
-                     origin_y);
+  // translate outside of the lock, so searches are not blocked meanwhile
+  size_t costmap_size = size_t(size_in_cells_x) * size_in_cells_y;
+  size_t current_size =
+      size_t(costmap_.getSizeInCellsX()) * costmap_.getSizeInCellsY();
+  if (staging_capacity_ < costmap_size) {
+    // leave some space when map grows, mapping usually grows map repeatedly
+    size_t capacity = costmap_size;
+    if (current_size > 0 && costmap_size > current_size) {
+      capacity += costmap_size / 4;
+    }
+    ROS_DEBUG("allocating map buffer for %lu cells", capacity);
+    staging_.reset(new unsigned char[capacity]);
+    staging_capacity_ = capacity;
+  }
+  size_t data_size = std::min(costmap_size, msg->data.size());
+  ROS_DEBUG("full map update, %lu values", costmap_size);
+  translateCosts(msg->data.data(), data_size, staging_.get());
+  std::fill(staging_.get() + data_size, staging_.get() + costmap_size,
+            costmap_.getDefaultValue());
+
+  // maps are often republished with the same geometry, only changed parts
+  // need to be reported then. The costmap is written only by this callback
+  // and updatePartialMap, both run on the single ros::spin() thread, so it
+  // can be read here without the lock. Searches only read the costmap.
+  bool same_geometry = size_in_cells_x == costmap_.getSizeInCellsX() &&
+                       size_in_cells_y == costmap_.getSizeInCellsY() &&
+                       resolution == costmap_.getResolution() &&
+                       origin_x == costmap_.getOriginX() &&
+                       origin_y == costmap_.getOriginY();
+  std::vector<MapRegion> changed;
+  if (same_geometry) {
+    diffRegions(staging_.get(), changed);
+  } else {
+    ROS_DEBUG("received full new map, resizing to: %d, %d", size_in_cells_x,
+              size_in_cells_y);
+  }
 
   // lock as we are accessing raw underlying map
   auto* mutex = costmap_.getMutex();
   std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*mutex);
 
-  // fill map with data
-  unsigned char* costmap_data = costmap_.getCharMap();
-  size_t costmap_size = costmap_.getSizeInCellsX() * costmap_.getSizeInCellsY();
-  ROS_DEBUG("full map update, %lu values", costmap_size);
-  for (size_t i = 0; i < costmap_size && i < msg->data.size(); ++i) {
-    unsigned char cell_cost = static_cast<unsigned char>(msg->data[i]);
-    costmap_data[i] = cost_translation_table__[cell_cost];
-  }
+  // swap in the new data, staging buffer gets the old one
+  costmap_.swapCharMap(staging_, size_in_cells_x, size_in_cells_y, resolution,
+                       origin_x, origin_y);
+  std::swap(staging_capacity_, costmap_capacity_);
   ROS_DEBUG("map updated, written %lu values", costmap_size);
+
+  if (!same_geometry) {
+    map_replaced_ = true;
+    updated_regions_.clear();
+    return;
+  }
+  for (const auto& region : changed) {
+    addUpdatedRegion(region);
+  }
+}
+
+void Costmap2DClient::diffRegions(const unsigned char* data,
+                                  std::vector<MapRegion>& regions) const
+{
+  // changes are reported as bounding boxes of bands of rows
+  constexpr static unsigned int band_size = 64;
+  const unsigned char* costmap_data = costmap_.getCharMap();
+  unsigned int size_x = costmap_.getSizeInCellsX();
+  unsigned int size_y = costmap_.getSizeInCellsY();
+  for (unsigned int band = 0; band < size_y; band += band_size) {
+    MapRegion region;
+    region.x0 = size_x;
+    region.y0 = size_y;
+    region.xn = 0;
+    region.yn = 0;
+    for (unsigned int y = band; y < size_y && y < band + band_size; ++y) {
+      const unsigned char* old_row = costmap_data + size_t(y) * size_x;
+      const unsigned char* new_row = data + size_t(y) * size_x;
+      if (std::equal(old_row, old_row + size_x, new_row)) {
+        continue;
+      }
+      unsigned int first = static_cast<unsigned int>(
+          std::mismatch(old_row, old_row + size_x, new_row).first - old_row);
+      unsigned int last = size_x;
+      while (old_row[last - 1] == new_row[last - 1]) {
+        --last;
+      }
+      region.x0 = std::min(region.x0, first);
+      region.xn = std::max(region.xn, last);
+      region.y0 = std::min(region.y0, y);
+      region.yn = y + 1;
+    }
+    if (region.xn > region.x0) {
+      regions.push_back(region);
+    }
+  }
 }
 
 void Costmap2DClient::updatePartialMap(
@@ -159,6 +234,18 @@ void Costmap2DClient::updatePartialMap(
   size_t xn = msg->width + x0;
   size_t yn = msg->height + y0;
 
+  size_t update_size = size_t(msg->width) * msg->height;
+  if (msg->data.size() < update_size) {
+    ROS_ERROR("update data too short, invalid update. expected %lu values, "
+              "got %lu",
+              update_size, msg->data.size());
+    return;
+  }
+
+  // translate outside of the lock, so searches are not blocked meanwhile
+  partial_staging_.resize(update_size);
+  translateCosts(msg->data.data(), update_size, partial_staging_.data());
+
   // lock as we are accessing raw underlying map
   auto* mutex = costmap_.getMutex();
   std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*mutex);
@@ -174,17 +261,58 @@ void Costmap2DClient::updatePartialMap(
              x0, xn, y0, yn, costmap_xn, costmap_yn);
   }
 
-  // update map with data
+  // update map with data, row by row
   unsigned char* costmap_data = costmap_.getCharMap();
-  size_t i = 0;
-  for (size_t y = y0; y < yn && y < costmap_yn; ++y) {
-    for (size_t x = x0; x < xn && x < costmap_xn; ++x) {
-      size_t idx = costmap_.getIndex(x, y);
-      unsigned char cell_cost = static_cast<unsigned char>(msg->data[i]);
-      costmap_data[idx] = cost_translation_table__[cell_cost];
-      ++i;
+  size_t row_size = x0 < costmap_xn ? std::min(xn, costmap_xn) - x0 : 0;
+  for (size_t y = y0; y < yn && y < costmap_yn && row_size > 0; ++y) {
+    std::copy_n(partial_staging_.data() + (y - y0) * msg->width, row_size,
+                costmap_data + costmap_.getIndex(x0, y));
+  }
+
+  // record changed region for incremental searches
+  if (x0 >= costmap_xn || y0 >= costmap_yn) {
+    return;
+  }
+  MapRegion region;
+  region.x0 = static_cast<unsigned int>(x0);
+  region.y0 = static_cast<unsigned int>(y0);
+  region.xn = static_cast<unsigned int>(std::min(xn, costmap_xn));
+  region.yn = static_cast<unsigned int>(std::min(yn, costmap_yn));
+  addUpdatedRegion(region);
+}
+
+void Costmap2DClient::addUpdatedRegion(const MapRegion& region)
+{
+  if (map_replaced_) {
+    return;
+  }
+  updated_regions_.push_back(region);
+  // nobody is consuming updates, don't let them grow without bound
+  constexpr static size_t max_regions = 256;
+  if (updated_regions_.size() > max_regions) {
+    MapRegion bounds = updated_regions_.front();
+    for (const auto& other : updated_regions_) {
+      bounds.x0 = std::min(bounds.x0, other.x0);
+      bounds.y0 = std::min(bounds.y0, other.y0);
+      bounds.xn = std::max(bounds.xn, other.xn);
+      bounds.yn = std::max(bounds.yn, other.yn);
     }
+    updated_regions_.assign(1, bounds);
+  }
+}
+
+bool Costmap2DClient::takeUpdatedRegions(std::vector<MapRegion>& regions)
+{
+  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*costmap_.getMutex());
+  bool replaced = map_replaced_;
+  if (!replaced) {
+    regions.insert(regions.end(), updated_regions_.begin(),
+                   updated_regions_.end());
   }
+  updated_regions_.clear();
+  map_replaced_ = false;
+
+  return replaced;
 }
 
 geometry_msgs::Pose Costmap2DClient::getRobotPose() const
@@ -230,23 +358,4 @@ geometry_msgs::Pose Costmap2DClient::getRobotPose() const
   return msg.pose;
 }
 
-std::array<unsigned char, 256> init_translation_table()
-{
-  std::array<unsigned char, 256> cost_translation_table;
-
-  // lineary mapped from [0..100] to [0..255]
-  for (size_t i = 0; i < 256; ++i) {
-    cost_translation_table[i] =
-        static_cast<unsigned char>(1 + (251 * (i - 1)) / 97);
-  }
-
-  // special values:
-  cost_translation_table[0] = 0;      // NO obstacle
-  cost_translation_table[99] = 253;   // INSCRIBED obstacle
-  cost_translation_table[100] = 254;  // LETHAL obstacle
-  cost_translation_table[static_cast<unsigned char>(-1)] = 255;  // UNKNOWN
-
-  return cost_translation_table;
-}
-
 }  // namespace explore
@@ -37,7 +37,17 @@
 
 #include <explore/explore.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <string>
 #include <thread>
+#include <utility>
+
+#include <geometry_msgs/PointStamped.h>
+
+#include <explore/cost_translation.h>
+#include <explore/costmap_grid_view.h>
+#include <explore/frontier_cells.h>
 
 inline static bool operator==(const geometry_msgs::Point& one,
                               const geometry_msgs::Point& two)
@@ -50,32 +60,81 @@ inline static bool operator==(const geometry_msgs::Point& one,
 
 namespace explore
 {
+// goals closer than this number of cells are considered the same goal
+constexpr static double blacklist_tolerance = 5;
+
 Explore::Explore()
   : private_nh_("~")
   , tf_listener_(ros::Duration(10.0))
   , costmap_client_(private_nh_, relative_nh_, &tf_listener_)
   , move_base_client_("move_base")
   , prev_distance_(0)
-  , last_markers_count_(0)
 {
   double timeout;
   double min_frontier_size;
+  bool incremental_search;
+  int search_threads;
+  bool path_distance;
+  double blacklist_timeout;
+  int blacklist_max_size;
+  int visualize_max_points;
   private_nh_.param("planner_frequency", planner_frequency_, 1.0);
   private_nh_.param("progress_timeout", timeout, 30.0);
   progress_timeout_ = ros::Duration(timeout);
   private_nh_.param("visualize", visualize_, false);
+  private_nh_.param("visualize_max_points", visualize_max_points, 100);
   private_nh_.param("potential_scale", potential_scale_, 1e-3);
   private_nh_.param("orientation_scale", orientation_scale_, 0.0);
   private_nh_.param("gain_scale", gain_scale_, 1.0);
   private_nh_.param("min_frontier_size", min_frontier_size, 0.5);
+  private_nh_.param("incremental_search", incremental_search, true);
+  private_nh_.param("search_threads", search_threads, 1);
+  private_nh_.param("path_distance", path_distance, false);
+  private_nh_.param("blacklist_timeout", blacklist_timeout, 0.0);
+  private_nh_.param("blacklist_max_size", blacklist_max_size, 1000);
+  private_nh_.param("diagnostics_frequency", diagnostics_frequency_, 1.0);
+  private_nh_.param("coordinated", coordinated_, false);
+  double frontier_goals_timeout;
+  private_nh_.param("frontier_goals_timeout", frontier_goals_timeout, 5.0);
+  frontier_goals_timeout_ = ros::Duration(frontier_goals_timeout);
+  if (search_threads <= 0) {
+    search_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
 
-  search_ = frontier_exploration::FrontierSearch(costmap_client_.getCostmap(),
-                                                 potential_scale_, gain_scale_,
-                                                 min_frontier_size);
+  search_ = frontier_exploration::FrontierSearch(
+      potential_scale_, gain_scale_, min_frontier_size, incremental_search,
+      static_cast<unsigned int>(search_threads), path_distance);
+  ROS_DEBUG("finding frontier cells using %s implementation",
+            frontier_exploration::frontierCellsImplementation());
+  ROS_DEBUG("translating costs using %s implementation",
+            costTranslationImplementation());
+  frontier_blacklist_ = FrontierBlacklist(
+      blacklist_tolerance * costmap_client_.getCostmap()->getResolution(),
+      ros::Duration(blacklist_timeout),
+      static_cast<size_t>(std::max(blacklist_max_size, 0)));
 
   if (visualize_) {
-    marker_array_publisher_ =
-        private_nh_.advertise<visualization_msgs::MarkerArray>("frontiers", 10);
+    visualizer_.reset(new FrontierVisualizer(
+        private_nh_, "frontiers",
+        static_cast<size_t>(std::max(visualize_max_points, 0))));
+  }
+
+  if (diagnostics_frequency_ > 0.) {
+    diagnostics_publisher_ =
+        relative_nh_.advertise<diagnostic_msgs::DiagnosticArray>(
+            "/diagnostics", 10);
+    diagnostics_timer_ = relative_nh_.createTimer(
+        ros::Duration(1. / diagnostics_frequency_),
+        [this](const ros::TimerEvent&) { publishDiagnostics(); });
+  }
+
+  if (coordinated_) {
+    frontier_goals_subscriber_ =
+        relative_nh_.subscribe<geometry_msgs::PoseArray>(
+            "frontier_goals", 1,
+            [this](const geometry_msgs::PoseArray::ConstPtr& msg) {
+              frontier_goals_ = msg;
+            });
   }
 
   ROS_INFO("Waiting to connect to move_base server");
@@ -92,134 +151,187 @@ Explore::~Explore()
   stop();
 }
 
-void Explore::visualizeFrontiers(
-    const std::vector<frontier_exploration::Frontier>& frontiers)
+void Explore::searchFrontiers(
+    const geometry_msgs::Pose& pose,
+    std::vector<frontier_exploration::Frontier>& frontiers)
 {
-  std_msgs::ColorRGBA blue;
-  blue.r = 0;
-  blue.g = 0;
-  blue.b = 1.0;
-  blue.a = 1.0;
-  std_msgs::ColorRGBA red;
-  red.r = 1.0;
-  red.g = 0;
-  red.b = 0;
-  red.a = 1.0;
-  std_msgs::ColorRGBA green;
-  green.r = 0;
-  green.g = 1.0;
-  green.b = 0;
-  green.a = 1.0;
-
-  ROS_DEBUG("visualising %lu frontiers", frontiers.size());
-  visualization_msgs::MarkerArray markers_msg;
-  std::vector<visualization_msgs::Marker>& markers = markers_msg.markers;
-  visualization_msgs::Marker m;
-
-  m.header.frame_id = costmap_client_.getGlobalFrameID();
-  m.header.stamp = ros::Time::now();
-  m.ns = "frontiers";
-  m.scale.x = 1.0;
-  m.scale.y = 1.0;
-  m.scale.z = 1.0;
-  m.color.r = 0;
-  m.color.g = 0;
-  m.color.b = 255;
-  m.color.a = 255;
-  // lives forever
-  m.lifetime = ros::Duration(0);
-  m.frame_locked = true;
-
-  // weighted frontiers are always sorted
-  double min_cost = frontiers.empty() ? 0. : frontiers.front().cost;
-
-  m.action = visualization_msgs::Marker::ADD;
-  size_t id = 0;
-  for (auto& frontier : frontiers) {
-    m.type = visualization_msgs::Marker::POINTS;
-    m.id = int(id);
-    m.pose.position = {};
-    m.scale.x = 0.1;
-    m.scale.y = 0.1;
-    m.scale.z = 0.1;
-    m.points = frontier.points;
-    if (goalOnBlacklist(frontier.centroid)) {
-      m.color = red;
-    } else {
-      m.color = blue;
+  {
+    // hold the lock, so no map update happens between collecting changed
+    // regions and the search
+    std::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(
+        *costmap_client_.getCostmap()->getMutex(), std::defer_lock);
+    {
+      ScopedTimer timer(stats_, "costmap_lock_wait");
+      lock.lock();
+    }
+    std::vector<Costmap2DClient::MapRegion> regions;
+    if (costmap_client_.takeUpdatedRegions(regions)) {
+      search_.markAllDirty();
+    }
+    for (const auto& region : regions) {
+      search_.markDirty(region.x0, region.y0, region.xn, region.yn);
     }
-    markers.push_back(m);
-    ++id;
-    m.type = visualization_msgs::Marker::SPHERE;
-    m.id = int(id);
-    m.pose.position = frontier.initial;
-    // scale frontier according to its cost (costier frontiers will be smaller)
-    double scale = std::min(std::abs(min_cost * 0.4 / frontier.cost), 0.5);
-    m.scale.x = scale;
-    m.scale.y = scale;
-    m.scale.z = scale;
-    m.points = {};
-    m.color = green;
-    markers.push_back(m);
-    ++id;
+    {
+      ScopedTimer timer(stats_, "search");
+      frontiers = search_.searchFrom(
+          frontier_exploration::costmapGridView(
+              *costmap_client_.getCostmap()),
+          pose.position);
+    }
+    // resolution may change with a new map
+    frontier_blacklist_.setTolerance(
+        blacklist_tolerance * costmap_client_.getCostmap()->getResolution());
+  }
+  const frontier_exploration::SearchStatistics& search_stats =
+      search_.lastStatistics();
+  switch (search_stats.result) {
+    case frontier_exploration::SearchResult::OUT_OF_BOUNDS:
+      ROS_ERROR("Robot out of costmap bounds, cannot search for frontiers");
+      break;
+    case frontier_exploration::SearchResult::NO_FREE_CELL:
+      ROS_WARN("Could not find nearby clear cell to start search");
+      break;
+    case frontier_exploration::SearchResult::FOUND:
+      break;
   }
-  size_t current_markers_count = markers.size();
+  stats_.add("search_nearest_cell", search_stats.nearest);
+  stats_.add("search_frontiers", search_stats.search);
+  stats_.add("search_costs", search_stats.costs);
+  stats_.count(search_stats.full ? "full_searches" : "incremental_searches");
+}
 
-  // delete previous markers, which are now unused
-  m.action = visualization_msgs::Marker::DELETE;
-  for (; id < last_markers_count_; ++id) {
-    m.id = int(id);
-    markers.push_back(m);
+bool Explore::assignedFrontiers(
+    const geometry_msgs::Pose& pose,
+    std::vector<frontier_exploration::Frontier>& frontiers)
+{
+  if (!frontier_goals_) {
+    ROS_WARN_THROTTLE(5.0, "Waiting for frontiers from coordinator");
+    return false;
+  }
+  // goals of an old allocation may be allocated to other robots now
+  ros::Duration age = ros::Time::now() - frontier_goals_->header.stamp;
+  if (age > frontier_goals_timeout_) {
+    ROS_WARN_THROTTLE(5.0, "Frontiers from coordinator are %.1f s old, "
+                           "waiting for new ones",
+                      age.toSec());
+    waitForCoordinator();
+    return false;
+  }
+  {
+    // resolution may change with a new map
+    std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(
+        *costmap_client_.getCostmap()->getMutex());
+    frontier_blacklist_.setTolerance(
+        blacklist_tolerance * costmap_client_.getCostmap()->getResolution());
   }
 
-  last_markers_count_ = current_markers_count;
-  marker_array_publisher_.publish(markers_msg);
+  // goals are in the frame of the map shared by robots
+  geometry_msgs::PointStamped goal, target;
+  goal.header.frame_id = frontier_goals_->header.frame_id;
+  goal.header.stamp = ros::Time();
+  for (const auto& goal_pose : frontier_goals_->poses) {
+    goal.point = goal_pose.position;
+    try {
+      tf_listener_.transformPoint(costmap_client_.getGlobalFrameID(), goal,
+                                  target);
+    } catch (tf::TransformException& ex) {
+      ROS_ERROR_THROTTLE(1.0, "Could not transform frontiers from "
+                              "coordinator: %s",
+                         ex.what());
+      return false;
+    }
+    frontier_exploration::Frontier frontier;
+    frontier.size = 1;
+    frontier.initial = target.point;
+    frontier.centroid = target.point;
+    frontier.middle = target.point;
+    double dx = target.point.x - pose.position.x;
+    double dy = target.point.y - pose.position.y;
+    frontier.min_distance = sqrt(dx * dx + dy * dy);
+    // goals are already ordered, keep the order
+    frontier.cost = double(frontiers.size() + 1);
+    frontiers.push_back(frontier);
+  }
+  return true;
 }
 
 void Explore::makePlan()
 {
+  ScopedTimer plan_timer(stats_, "plan");
+  stats_.count("plans");
   // find frontiers
-  auto pose = costmap_client_.getRobotPose();
+  geometry_msgs::Pose pose;
+  {
+    ScopedTimer timer(stats_, "robot_pose");
+    pose = costmap_client_.getRobotPose();
+  }
   // get frontiers sorted according to cost
-  auto frontiers = search_.searchFrom(pose.position);
-  ROS_DEBUG("found %lu frontiers", frontiers.size());
-  for (size_t i = 0; i < frontiers.size(); ++i) {
-    ROS_DEBUG("frontier %zd cost: %f", i, frontiers[i].cost);
+  std::vector<frontier_exploration::Frontier> frontiers;
+  if (!coordinated_) {
+    searchFrontiers(pose, frontiers);
+  } else if (!assignedFrontiers(pose, frontiers)) {
+    return;
   }
+  stats_.count("frontiers_found", frontiers.size());
+  frontier_blacklist_.removeExpired(ros::Time::now());
+  ROS_DEBUG("found %lu frontiers", frontiers.size());
 
   if (frontiers.empty()) {
-    stop();
+    if (coordinated_) {
+      // the coordinator has nothing for us now, it may have later
+      ROS_INFO_THROTTLE(5.0, "No frontiers allocated by coordinator");
+      waitForCoordinator();
+    } else {
+      stop();
+    }
     return;
   }
 
-  // publish frontiers as visualization markers
-  if (visualize_) {
-    visualizeFrontiers(frontiers);
-  }
-
   // find non blacklisted frontier
   auto frontier =
       std::find_if_not(frontiers.begin(), frontiers.end(),
                        [this](const frontier_exploration::Frontier& f) {
                          return goalOnBlacklist(f.centroid);
                        });
-  if (frontier == frontiers.end()) {
+  bool found = frontier != frontiers.end();
+  geometry_msgs::Point target_position;
+  double target_distance = 0.;
+  if (found) {
+    target_position = frontier->centroid;
+    target_distance = frontier->min_distance;
+  }
+
+  // publish frontiers as visualization markers, frontiers are handed over
+  // to the visualizer
+  if (visualizer_) {
+    ScopedTimer timer(stats_, "visualization");
+    std::vector<bool> blacklisted;
+    blacklisted.reserve(frontiers.size());
+    for (const auto& f : frontiers) {
+      blacklisted.push_back(goalOnBlacklist(f.centroid));
+    }
+    visualizer_->publish(std::move(frontiers), std::move(blacklisted),
+                         costmap_client_.getGlobalFrameID());
+  }
+
+  if (!found) {
     stop();
     return;
   }
-  geometry_msgs::Point target_position = frontier->centroid;
 
   // time out if we are not making any progress
-  bool same_goal = prev_goal_ == target_position;
+  bool same_goal = !goal_cancelled_ && prev_goal_ == target_position;
   prev_goal_ = target_position;
-  if (!same_goal || prev_distance_ > frontier->min_distance) {
+  goal_cancelled_ = false;
+  if (!same_goal || prev_distance_ > target_distance) {
     // we have different goal or we made some progress
     last_progress_ = ros::Time::now();
-    prev_distance_ = frontier->min_distance;
+    prev_distance_ = target_distance;
   }
   // black list if we've made no progress for a long time
   if (ros::Time::now() - last_progress_ > progress_timeout_) {
-    frontier_blacklist_.push_back(target_position);
+    frontier_blacklist_.add(target_position, ros::Time::now());
+    stats_.count("goals_blacklisted");
     ROS_DEBUG("Adding current goal to black list");
     makePlan();
     return;
@@ -231,6 +343,8 @@ void Explore::makePlan()
   }
 
   // send goal to move_base if we have something new to pursue
+  ScopedTimer timer(stats_, "goal_dispatch");
+  stats_.count("goals_sent");
   move_base_msgs::MoveBaseGoal goal;
   goal.target_pose.pose.position = target_position;
   goal.target_pose.pose.orientation.w = 1.;
@@ -246,19 +360,47 @@ void Explore::makePlan()
 
 bool Explore::goalOnBlacklist(const geometry_msgs::Point& goal)
 {
-  constexpr static size_t tolerace = 5;
-  costmap_2d::Costmap2D* costmap2d = costmap_client_.getCostmap();
-
   // check if a goal is on the blacklist for goals that we're pursuing
-  for (auto& frontier_goal : frontier_blacklist_) {
-    double x_diff = fabs(goal.x - frontier_goal.x);
-    double y_diff = fabs(goal.y - frontier_goal.y);
+  return frontier_blacklist_.contains(goal, ros::Time::now());
+}
 
-    if (x_diff < tolerace * costmap2d->getResolution() &&
-        y_diff < tolerace * costmap2d->getResolution())
-      return true;
+void Explore::publishDiagnostics()
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.name = ros::this_node::getName() + ": planning";
+  status.message = "planning latencies and counters";
+  auto add_value = [&status](const std::string& key,
+                             const std::string& value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = value;
+    status.values.push_back(key_value);
+  };
+  auto milliseconds = [](double seconds) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", seconds * 1000.);
+    return std::string(buffer);
+  };
+
+  // latencies are reported in milliseconds
+  for (const auto& stage : stats_.summaries()) {
+    const LatencyStats::Summary& summary = stage.second;
+    add_value(stage.first + " last [ms]", milliseconds(summary.last));
+    add_value(stage.first + " p50 [ms]", milliseconds(summary.p50));
+    add_value(stage.first + " p95 [ms]", milliseconds(summary.p95));
+    add_value(stage.first + " p99 [ms]", milliseconds(summary.p99));
+    add_value(stage.first + " max [ms]", milliseconds(summary.max));
+  }
+  for (const auto& counter : stats_.counters()) {
+    add_value(counter.first, std::to_string(counter.second));
   }
-  return false;
+  add_value("blacklist_size", std::to_string(frontier_blacklist_.size()));
+
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  msg.status.push_back(status);
+  diagnostics_publisher_.publish(msg);
 }
 
 void Explore::reachedGoal(const actionlib::SimpleClientGoalState& status,
@@ -267,7 +409,9 @@ void Explore::reachedGoal(const actionlib::SimpleClientGoalState& status,
 {
   ROS_DEBUG("Reached goal with status: %s", status.toString().c_str());
   if (status == actionlib::SimpleClientGoalState::ABORTED) {
-    frontier_blacklist_.push_back(frontier_goal);
+    frontier_blacklist_.add(frontier_goal, ros::Time::now());
+    stats_.count("goals_aborted");
+    stats_.count("goals_blacklisted");
     ROS_DEBUG("Adding current goal to black list");
   }
 
@@ -280,6 +424,14 @@ void Explore::reachedGoal(const actionlib::SimpleClientGoalState& status,
       true);
 }
 
+void Explore::waitForCoordinator()
+{
+  if (!goal_cancelled_) {
+    move_base_client_.cancelAllGoals();
+    goal_cancelled_ = true;
+  }
+}
+
 void Explore::start()
 {
   exploring_timer_.start();
@@ -0,0 +1,229 @@
+#include <explore/frontier_allocator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <explore/costmap_tools.h>
+
+namespace frontier_exploration
+{
+std::vector<int> assignMinCost(const std::vector<std::vector<double>>& costs)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  size_t rows = costs.size();
+  size_t cols = rows > 0 ? costs[0].size() : 0;
+  std::vector<int> assignment(rows, -1);
+
+  // the method needs finite costs. forbidden pairs cost more than any
+  // assignment with one forbidden pair less.
+  double low = inf, high = -inf;
+  for (const auto& row : costs) {
+    for (double cost : row) {
+      if (std::isfinite(cost)) {
+        low = std::min(low, cost);
+        high = std::max(high, cost);
+      }
+    }
+  }
+  if (low > high) {
+    // nothing can be assigned
+    return assignment;
+  }
+
+  // method assigns all of n rows to m >= n columns
+  bool transposed = rows > cols;
+  size_t n = transposed ? cols : rows;
+  size_t m = transposed ? rows : cols;
+  double forbidden = high + (high - low + 1.) * n;
+  auto cost = [&](size_t i, size_t j) {
+    double c = transposed ? costs[j][i] : costs[i][j];
+    return std::isfinite(c) ? c : forbidden;
+  };
+
+  // potentials u, v and matching p of columns to rows are 1-based, column 0
+  // is a sentinel for the row being added
+  std::vector<double> u(n + 1, 0.), v(m + 1, 0.), minv(m + 1);
+  std::vector<size_t> p(m + 1, 0), way(m + 1, 0);
+  std::vector<bool> used(m + 1);
+  for (size_t i = 1; i <= n; ++i) {
+    p[0] = i;
+    size_t j0 = 0;
+    minv.assign(m + 1, inf);
+    used.assign(m + 1, false);
+    // find augmenting path for row i
+    do {
+      used[j0] = true;
+      size_t i0 = p[j0], j1 = 0;
+      double delta = inf;
+      for (size_t j = 1; j <= m; ++j) {
+        if (used[j]) {
+          continue;
+        }
+        double reduced = cost(i0 - 1, j - 1) - u[i0] - v[j];
+        if (reduced < minv[j]) {
+          minv[j] = reduced;
+          way[j] = j0;
+        }
+        if (minv[j] < delta) {
+          delta = minv[j];
+          j1 = j;
+        }
+      }
+      for (size_t j = 0; j <= m; ++j) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    // flip the path
+    do {
+      size_t j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  for (size_t j = 1; j <= m; ++j) {
+    if (p[j] == 0) {
+      continue;
+    }
+    size_t row = transposed ? j - 1 : p[j] - 1;
+    size_t col = transposed ? p[j] - 1 : j - 1;
+    if (std::isfinite(costs[row][col])) {
+      assignment[row] = static_cast<int>(col);
+    }
+  }
+  return assignment;
+}
+
+FrontierAllocator::FrontierAllocator(double potential_scale,
+                                     double gain_scale)
+  : potential_scale_(potential_scale)
+  , gain_scale_(gain_scale)
+  , targeted_frontiers_(0)
+{
+}
+
+std::vector<std::vector<size_t>>
+FrontierAllocator::allocate(const GridView& grid,
+                            const std::vector<Frontier>& frontiers,
+                            const std::vector<geometry_msgs::Point>& robots)
+{
+  grid_ = grid;
+
+  // register cells of all frontiers as path targets
+  targets_.clear();
+  targeted_frontiers_ = 0;
+  for (size_t i = 0; i < frontiers.size(); ++i) {
+    bool targeted = false;
+    auto add_target = [&](const geometry_msgs::Point& point) {
+      unsigned int mx, my;
+      if (grid_.worldToMap(point.x, point.y, mx, my)) {
+        targets_.emplace(grid_.getIndex(mx, my), i);
+        targeted = true;
+      }
+    };
+    add_target(frontiers[i].initial);
+    for (const auto& point : frontiers[i].points) {
+      add_target(point);
+    }
+    if (targeted) {
+      ++targeted_frontiers_;
+    }
+  }
+
+  // costs of frontiers for each robot, same cost function as in the search
+  std::vector<std::vector<double>> costs(robots.size());
+  for (size_t r = 0; r < robots.size(); ++r) {
+    pathDistances(robots[r], frontiers.size(), costs[r]);
+    for (size_t i = 0; i < frontiers.size(); ++i) {
+      costs[r][i] = (potential_scale_ * costs[r][i] * grid_.resolution) -
+                    (gain_scale_ * frontiers[i].size * grid_.resolution);
+    }
+  }
+
+  std::vector<int> assignment = assignMinCost(costs);
+  std::vector<bool> assigned(frontiers.size(), false);
+  for (int frontier : assignment) {
+    if (frontier >= 0) {
+      assigned[size_t(frontier)] = true;
+    }
+  }
+
+  std::vector<std::vector<size_t>> result(robots.size());
+  for (size_t r = 0; r < robots.size(); ++r) {
+    std::vector<size_t>& order = result[r];
+    const std::vector<double>& cost = costs[r];
+    for (size_t i = 0; i < frontiers.size(); ++i) {
+      if (std::isfinite(cost[i]) && int(i) != assignment[r]) {
+        order.push_back(i);
+      }
+    }
+    // frontiers of other robots go last, they are used only when the robot
+    // can't pursue any other
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      if (assigned[a] != assigned[b]) {
+        return bool(assigned[b]);
+      }
+      return cost[a] < cost[b];
+    });
+    if (assignment[r] >= 0) {
+      order.insert(order.begin(), size_t(assignment[r]));
+    }
+  }
+
+  return result;
+}
+
+void FrontierAllocator::pathDistances(geometry_msgs::Point position,
+                                      size_t frontiers,
+                                      std::vector<double>& distances)
+{
+  distances.assign(frontiers, std::numeric_limits<double>::infinity());
+
+  unsigned int mx, my;
+  if (!grid_.worldToMap(position.x, position.y, mx, my)) {
+    return;
+  }
+  // start from the closest free cell, as the search does
+  unsigned int start, pos = grid_.getIndex(mx, my);
+  if (!nearestCell(start, pos, FREE_SPACE, grid_, bfs_, visited_)) {
+    start = pos;
+  }
+
+  visited_.resize(size_t(grid_.size_x) * grid_.size_y);
+  distance_.resize(size_t(grid_.size_x) * grid_.size_y);
+  bfs_.clear();
+  bfs_.push(start);
+  visited_.set(start);
+  distance_[start] = 0;
+  size_t remaining = targeted_frontiers_;
+  while (!bfs_.empty() && remaining > 0) {
+    unsigned int idx = bfs_.front();
+    bfs_.pop();
+
+    for (unsigned int nbr : nhood4(idx, grid_)) {
+      if (visited_.test(nbr)) {
+        continue;
+      }
+      visited_.set(nbr);
+      // breadth first order reaches each frontier by its shortest path first
+      auto target = targets_.find(nbr);
+      if (target != targets_.end() &&
+          std::isinf(distances[target->second])) {
+        distances[target->second] = (distance_[idx] + 1) * grid_.resolution;
+        --remaining;
+      }
+      if (grid_.data[nbr] == FREE_SPACE) {
+        distance_[nbr] = distance_[idx] + 1;
+        bfs_.push(nbr);
+      }
+    }
+  }
+}
+}
@@ -0,0 +1,156 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_blacklist.h>
+
+#include <cmath>
+
+namespace explore
+{
+FrontierBlacklist::FrontierBlacklist(double tolerance, ros::Duration timeout,
+                                     size_t max_size)
+  : tolerance_(tolerance), timeout_(timeout), max_size_(max_size)
+{
+}
+
+void FrontierBlacklist::setTolerance(double tolerance)
+{
+  if (tolerance == tolerance_) {
+    return;
+  }
+
+  tolerance_ = tolerance;
+  cells_.clear();
+  for (const auto& entry : entries_) {
+    cells_[key(entry.goal)].push_back(entry);
+  }
+}
+
+void FrontierBlacklist::add(const geometry_msgs::Point& goal,
+                            const ros::Time& now)
+{
+  // the same goal is often blacklisted repeatedly, keep just one entry
+  auto it = cells_.find(key(goal));
+  if (it != cells_.end()) {
+    for (const auto& entry : it->second) {
+      if (entry.goal.x == goal.x && entry.goal.y == goal.y &&
+          !expired(entry, now)) {
+        return;
+      }
+    }
+  }
+
+  Entry entry;
+  entry.goal = goal;
+  entry.stamp = now;
+  entries_.push_back(entry);
+  cells_[key(goal)].push_back(entry);
+  if (max_size_ > 0 && entries_.size() > max_size_) {
+    removeOldest();
+  }
+}
+
+bool FrontierBlacklist::contains(const geometry_msgs::Point& goal,
+                                 const ros::Time& now) const
+{
+  // cells are tolerance-sized, so all goals within tolerance are in
+  // neighbouring cells
+  std::int64_t x = cell(goal.x);
+  std::int64_t y = cell(goal.y);
+  for (std::int64_t dx = -1; dx <= 1; ++dx) {
+    for (std::int64_t dy = -1; dy <= 1; ++dy) {
+      auto it = cells_.find(key(x + dx, y + dy));
+      if (it == cells_.end()) {
+        continue;
+      }
+      for (const auto& entry : it->second) {
+        if (fabs(goal.x - entry.goal.x) < tolerance_ &&
+            fabs(goal.y - entry.goal.y) < tolerance_ &&
+            !expired(entry, now)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void FrontierBlacklist::removeExpired(const ros::Time& now)
+{
+  while (!entries_.empty() && expired(entries_.front(), now)) {
+    removeOldest();
+  }
+}
+
+void FrontierBlacklist::removeOldest()
+{
+  // entries of each cell are in order of insertion as well, so the oldest
+  // entry is the first one in its cell
+  auto it = cells_.find(key(entries_.front().goal));
+  if (it != cells_.end()) {
+    auto& cell_entries = it->second;
+    cell_entries.erase(cell_entries.begin());
+    if (cell_entries.empty()) {
+      cells_.erase(it);
+    }
+  }
+  entries_.pop_front();
+}
+
+std::int64_t FrontierBlacklist::key(const geometry_msgs::Point& point) const
+{
+  return key(cell(point.x), cell(point.y));
+}
+
+std::int64_t FrontierBlacklist::key(std::int64_t x, std::int64_t y) const
+{
+  // pack both coordinates to one key, 32 bits is plenty for grid cells
+  std::uint64_t high = static_cast<std::uint64_t>(x) << 32;
+  std::uint64_t low = static_cast<std::uint64_t>(y) & 0xffffffff;
+  return static_cast<std::int64_t>(high ^ low);
+}
+
+std::int64_t FrontierBlacklist::cell(double coordinate) const
+{
+  return static_cast<std::int64_t>(std::floor(coordinate / tolerance_));
+}
+
+bool FrontierBlacklist::expired(const Entry& entry, const ros::Time& now) const
+{
+  return !timeout_.isZero() && entry.stamp + timeout_ < now;
+}
+
+}  // namespace explore
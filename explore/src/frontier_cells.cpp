@@ -0,0 +1,221 @@
+#include <explore/frontier_cells.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <explore/grid_view.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRONTIER_CELLS_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FRONTIER_CELLS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace frontier_exploration
+{
+namespace
+{
+/* Row kernels process cells of an interior row, i.e. all cells must have all
+ * 4 neighbours. They process as many cells as fits to whole vectors and return
+ * number of processed cells. */
+typedef size_t (*RowKernel)(const unsigned char* center, size_t stride,
+                            size_t n, unsigned char* out);
+
+inline unsigned char frontierCell(const unsigned char* map,
+                                  unsigned int size_x, unsigned int size_y,
+                                  unsigned int x, unsigned int y)
+{
+  const unsigned char* cell = map + size_t(y) * size_x + x;
+  if (*cell != NO_INFORMATION) {
+    return 0;
+  }
+  bool has_free = (x > 0 && cell[-1] == FREE_SPACE) ||
+                  (x < size_x - 1 && cell[1] == FREE_SPACE) ||
+                  (y > 0 && cell[-ptrdiff_t(size_x)] == FREE_SPACE) ||
+                  (y < size_y - 1 && cell[size_x] == FREE_SPACE);
+  return has_free ? 1 : 0;
+}
+
+size_t rowScalar(const unsigned char*, size_t, size_t, unsigned char*)
+{
+  return 0;
+}
+
+#ifdef FRONTIER_CELLS_X86
+__attribute__((target("sse2"))) size_t rowSSE2(const unsigned char* center,
+                                               size_t stride, size_t n,
+                                               unsigned char* out)
+{
+  const __m128i unknown = _mm_set1_epi8(char(NO_INFORMATION));
+  const __m128i free_space = _mm_set1_epi8(char(FREE_SPACE));
+  const __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const unsigned char* p = center + i;
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - 1));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+    __m128i u =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p - stride));
+    __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + stride));
+    __m128i has_free = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(l, free_space),
+                     _mm_cmpeq_epi8(r, free_space)),
+        _mm_or_si128(_mm_cmpeq_epi8(u, free_space),
+                     _mm_cmpeq_epi8(d, free_space)));
+    __m128i mask = _mm_and_si128(_mm_cmpeq_epi8(c, unknown), has_free);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_and_si128(mask, one));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) size_t rowAVX2(const unsigned char* center,
+                                               size_t stride, size_t n,
+                                               unsigned char* out)
+{
+  const __m256i unknown = _mm256_set1_epi8(char(NO_INFORMATION));
+  const __m256i free_space = _mm256_set1_epi8(char(FREE_SPACE));
+  const __m256i one = _mm256_set1_epi8(1);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const unsigned char* p = center + i;
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p - 1));
+    __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+    __m256i u =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p - stride));
+    __m256i d =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + stride));
+    __m256i has_free = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(l, free_space),
+                        _mm256_cmpeq_epi8(r, free_space)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(u, free_space),
+                        _mm256_cmpeq_epi8(d, free_space)));
+    __m256i mask = _mm256_and_si256(_mm256_cmpeq_epi8(c, unknown), has_free);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_and_si256(mask, one));
+  }
+  // finish with narrower vectors
+  return i + rowSSE2(center + i, stride, n - i, out + i);
+}
+#endif
+
+#ifdef FRONTIER_CELLS_NEON
+size_t rowNEON(const unsigned char* center, size_t stride, size_t n,
+               unsigned char* out)
+{
+  const uint8x16_t unknown = vdupq_n_u8(NO_INFORMATION);
+  const uint8x16_t free_space = vdupq_n_u8(FREE_SPACE);
+  const uint8x16_t one = vdupq_n_u8(1);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const unsigned char* p = center + i;
+    uint8x16_t c = vld1q_u8(p);
+    uint8x16_t l = vld1q_u8(p - 1);
+    uint8x16_t r = vld1q_u8(p + 1);
+    uint8x16_t u = vld1q_u8(p - stride);
+    uint8x16_t d = vld1q_u8(p + stride);
+    uint8x16_t has_free =
+        vorrq_u8(vorrq_u8(vceqq_u8(l, free_space), vceqq_u8(r, free_space)),
+                 vorrq_u8(vceqq_u8(u, free_space), vceqq_u8(d, free_space)));
+    uint8x16_t mask = vandq_u8(vceqq_u8(c, unknown), has_free);
+    vst1q_u8(out + i, vandq_u8(mask, one));
+  }
+  return i;
+}
+#endif
+
+struct Implementation {
+  RowKernel kernel;
+  const char* name;
+};
+
+std::vector<Implementation> supportedImplementations()
+{
+  std::vector<Implementation> supported;
+#ifdef FRONTIER_CELLS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    supported.push_back({rowAVX2, "avx2"});
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    supported.push_back({rowSSE2, "sse2"});
+  }
+#endif
+#ifdef FRONTIER_CELLS_NEON
+  supported.push_back({rowNEON, "neon"});
+#endif
+  supported.push_back({rowScalar, "scalar"});
+  return supported;
+}
+
+// supported implementations, the fastest first
+const std::vector<Implementation>& implementations()
+{
+  // detected once, initialization is thread-safe
+  static const std::vector<Implementation> supported =
+      supportedImplementations();
+  return supported;
+}
+
+void findCells(RowKernel kernel, const unsigned char* map, unsigned int size_x,
+               unsigned int size_y, unsigned int y0, unsigned int yn,
+               unsigned char* mask)
+{
+  for (unsigned int y = y0; y < yn && y < size_y; ++y) {
+    size_t row = size_t(y) * size_x;
+    unsigned int x = 0;
+    // vectorized kernels need all neighbours, handle only interior cells
+    if (y > 0 && y < size_y - 1 && size_x > 2) {
+      mask[row] = frontierCell(map, size_x, size_y, 0, y);
+      x = 1 + static_cast<unsigned int>(kernel(map + row + 1, size_x,
+                                               size_x - 2, mask + row + 1));
+    }
+    for (; x < size_x; ++x) {
+      mask[row + x] = frontierCell(map, size_x, size_y, x, y);
+    }
+  }
+}
+}  // namespace
+
+void findFrontierCells(const unsigned char* map, unsigned int size_x,
+                       unsigned int size_y, unsigned int y0, unsigned int yn,
+                       unsigned char* mask)
+{
+  findCells(implementations().front().kernel, map, size_x, size_y, y0, yn,
+            mask);
+}
+
+bool findFrontierCells(const std::string& implementation,
+                       const unsigned char* map, unsigned int size_x,
+                       unsigned int size_y, unsigned int y0, unsigned int yn,
+                       unsigned char* mask)
+{
+  for (const auto& impl : implementations()) {
+    if (implementation == impl.name) {
+      findCells(impl.kernel, map, size_x, size_y, y0, yn, mask);
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> frontierCellsImplementations()
+{
+  std::vector<std::string> names;
+  for (const auto& impl : implementations()) {
+    names.push_back(impl.name);
+  }
+  return names;
+}
+
+const char* frontierCellsImplementation()
+{
+  return implementations().front().name;
+}
+}
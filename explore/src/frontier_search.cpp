@@ -1,105 +1,553 @@
 #include <explore/frontier_search.h>
 
-#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
-#include <costmap_2d/cost_values.h>
-#include <costmap_2d/costmap_2d.h>
 #include <geometry_msgs/Point.h>
 
 #include <explore/costmap_tools.h>
+#include <explore/frontier_cells.h>
 
 namespace frontier_exploration
 {
-using costmap_2d::LETHAL_OBSTACLE;
-using costmap_2d::NO_INFORMATION;
-using costmap_2d::FREE_SPACE;
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
 
-FrontierSearch::FrontierSearch(costmap_2d::Costmap2D* costmap,
-                               double potential_scale, double gain_scale,
-                               double min_frontier_size)
-  : costmap_(costmap)
+// runs f(i) for all i in [0, n) distributed over threads
+template <typename F>
+static void parallelFor(size_t n, unsigned int threads, F f)
+{
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      f(i);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < threads && i < n; ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+FrontierSearch::FrontierSearch(double potential_scale, double gain_scale,
+                               double min_frontier_size, bool incremental,
+                               unsigned int threads, bool path_distance)
+  : map_(nullptr)
+  , size_x_(0)
+  , size_y_(0)
   , potential_scale_(potential_scale)
   , gain_scale_(gain_scale)
   , min_frontier_size_(min_frontier_size)
+  , incremental_(incremental)
+  , threads_(std::max(threads, 1u))
+  , path_distance_(path_distance)
+{
+}
+
+void FrontierSearch::markDirty(unsigned int x0, unsigned int y0,
+                               unsigned int xn, unsigned int yn)
+{
+  dirty_regions_.push_back({x0, y0, xn, yn});
+}
+
+void FrontierSearch::markAllDirty()
 {
+  all_dirty_ = true;
+  dirty_regions_.clear();
 }
 
-std::vector<Frontier> FrontierSearch::searchFrom(geometry_msgs::Point position)
+std::vector<Frontier> FrontierSearch::searchFrom(const GridView& grid,
+                                                 geometry_msgs::Point position)
 {
   std::vector<Frontier> frontier_list;
 
-  // Sanity check that robot is inside costmap bounds before searching
+  // Sanity check that robot is inside grid bounds before searching
   unsigned int mx, my;
-  if (!costmap_->worldToMap(position.x, position.y, mx, my)) {
-    ROS_ERROR("Robot out of costmap bounds, cannot search for frontiers");
+  if (!grid.worldToMap(position.x, position.y, mx, my)) {
+    statistics_.result = SearchResult::OUT_OF_BOUNDS;
     return frontier_list;
   }
 
-  // make sure map is consistent and locked for duration of search
-  std::lock_guard<costmap_2d::Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
+  grid_ = grid;
+  map_ = grid_.data;
+  if (size_x_ != grid_.size_x || size_y_ != grid_.size_y) {
+    // previous results are useless for map of different size
+    all_dirty_ = true;
+  }
+  size_x_ = grid_.size_x;
+  size_y_ = grid_.size_y;
+  // queues are bounded roughly by perimeter of searched region
+  bfs_.reserve(2 * (size_x_ + size_y_));
+  frontier_bfs_.reserve(2 * (size_x_ + size_y_));
+
+  auto stage_start = std::chrono::steady_clock::now();
+  // find closest clear cell to start search
+  unsigned int clear, pos = grid_.getIndex(mx, my);
+  bool found_clear =
+      nearestCell(clear, pos, FREE_SPACE, grid_, bfs_, nearest_visited_);
+  statistics_.result = SearchResult::FOUND;
+  if (!found_clear) {
+    clear = pos;
+    statistics_.result = SearchResult::NO_FREE_CELL;
+  }
+  statistics_.nearest = secondsSince(stage_start);
+  stage_start = std::chrono::steady_clock::now();
+
+  // previous results can be reused only if the robot is still in the same
+  // free region
+  bool repaired = incremental_ && !all_dirty_ && reachable_free_ &&
+                  found_clear && reachable_flag_[clear] && repairDirty();
+  if (!repaired) {
+    searchFull(clear);
+  } else if (path_distance_) {
+    // distances are relative to the robot, they can't be repaired
+    computePathDistances(clear);
+  }
+  dirty_regions_.clear();
+  all_dirty_ = false;
+  statistics_.full = !repaired;
+  statistics_.search = secondsSince(stage_start);
+  stage_start = std::chrono::steady_clock::now();
+
+  std::vector<const Cluster*> selected;
+  for (const auto& cluster : clusters_) {
+    // skip unused slots
+    if (cluster.cells.empty()) {
+      continue;
+    }
+    if (cluster.frontier.size * grid_.resolution < min_frontier_size_) {
+      continue;
+    }
+    selected.push_back(&cluster);
+  }
+
+  // set distances and costs of frontiers
+  frontier_list.resize(selected.size());
+  parallelFor(selected.size(), threads_, [&](size_t i) {
+    Frontier& frontier = frontier_list[i];
+    frontier = selected[i]->frontier;
+    updateDistance(frontier, selected[i]->cells, pos);
+    frontier.cost = frontierCost(frontier);
+  });
+  std::sort(
+      frontier_list.begin(), frontier_list.end(),
+      [](const Frontier& f1, const Frontier& f2) { return f1.cost < f2.cost; });
+  statistics_.costs = secondsSince(stage_start);
 
-  map_ = costmap_->getCharMap();
-  size_x_ = costmap_->getSizeInCellsX();
-  size_y_ = costmap_->getSizeInCellsY();
+  return frontier_list;
+}
 
+void FrontierSearch::searchFull(unsigned int start)
+{
   // initialize flag arrays to keep track of visited and frontier cells
-  std::vector<bool> frontier_flag(size_x_ * size_y_, false);
-  std::vector<bool> visited_flag(size_x_ * size_y_, false);
+  reachable_flag_.assign(size_x_ * size_y_, false);
+  frontier_flag_.assign(size_x_ * size_y_, false);
+  clusters_.clear();
+  free_clusters_.clear();
+  cell_cluster_.clear();
+
+  // search initialized on non-free cell can't be repaired later
+  reachable_free_ = map_[start] == FREE_SPACE;
+
+  // find all frontier cells in one sweep
+  frontier_cells_.resize(size_x_ * size_y_);
+  parallelFor(threads_, threads_, [this](size_t i) {
+    findFrontierCells(map_, size_x_, size_y_,
+                      static_cast<unsigned int>(i * size_y_ / threads_),
+                      static_cast<unsigned int>((i + 1) * size_y_ / threads_),
+                      frontier_cells_.data());
+  });
 
   // initialize breadth first search
-  std::queue<unsigned int> bfs;
-
-  // find closest clear cell to start search
-  unsigned int clear, pos = costmap_->getIndex(mx, my);
-  if (nearestCell(clear, pos, FREE_SPACE, *costmap_)) {
-    bfs.push(clear);
+  bfs_.clear();
+  bfs_.push(start);
+  reachable_flag_[start] = true;
+  if (path_distance_) {
+    // breadth first search will record distances from start
+    path_visited_.resize(size_x_ * size_y_);
+    distance_.resize(size_x_ * size_y_);
+    path_visited_.set(start);
+    distance_[start] = 0;
+  }
+  if (threads_ > 1) {
+    expandReachable(false);
+    buildFrontiersParallel();
   } else {
-    bfs.push(pos);
-    ROS_WARN("Could not find nearby clear cell to start search");
+    expandReachable(true);
+  }
+}
+
+void FrontierSearch::buildFrontiersParallel()
+{
+  // split map to horizontal bands, lets have more bands than threads to
+  // balance the load
+  struct Band {
+    unsigned int y0, yn;
+    // frontier cells in scan order
+    std::vector<unsigned int> cells;
+    // union-find forest over cells, with global ids
+    std::vector<size_t> parent;
+    // whether cell has reachable neighbour
+    std::vector<bool> touches_reachable;
+    // global ids of frontier cells in first and last row, or -1
+    std::vector<size_t> first_row, last_row;
+  };
+  constexpr static size_t none = std::numeric_limits<size_t>::max();
+  size_t bands_count = std::min<size_t>(4 * threads_, size_y_);
+  std::vector<Band> bands(bands_count);
+  for (size_t b = 0; b < bands_count; ++b) {
+    bands[b].y0 = static_cast<unsigned int>(b * size_y_ / bands_count);
+    bands[b].yn = static_cast<unsigned int>((b + 1) * size_y_ / bands_count);
+  }
+
+  auto find = [](std::vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  };
+  auto unite = [&find](std::vector<size_t>& parent, size_t a, size_t b) {
+    a = find(parent, a);
+    b = find(parent, b);
+    // keep lower id as root, so root is the first cell in scan order
+    if (a < b) {
+      parent[b] = a;
+    } else {
+      parent[a] = b;
+    }
+  };
+
+  // label frontier cells in each band independently. ids are local to band
+  // for now.
+  parallelFor(bands_count, threads_, [&](size_t b) {
+    Band& band = bands[b];
+    std::vector<size_t> prev_row(size_x_, none), row(size_x_, none);
+    for (unsigned int y = band.y0; y < band.yn; ++y) {
+      for (unsigned int x = 0; x < size_x_; ++x) {
+        unsigned int idx = y * size_x_ + x;
+        row[x] = none;
+        if (!frontier_cells_[idx]) {
+          continue;
+        }
+        bool has_reachable = false;
+        for (unsigned int nbr : nhood4(idx, grid_)) {
+          has_reachable = has_reachable || reachable_flag_[nbr];
+        }
+
+        size_t id = band.cells.size();
+        row[x] = id;
+        band.cells.push_back(idx);
+        band.parent.push_back(id);
+        band.touches_reachable.push_back(has_reachable);
+        // join 8-connected neighbours already labeled
+        if (x > 0 && row[x - 1] != none) {
+          unite(band.parent, id, row[x - 1]);
+        }
+        if (y > band.y0) {
+          for (unsigned int nx = x > 0 ? x - 1 : 0;
+               nx <= x + 1 && nx < size_x_; ++nx) {
+            if (prev_row[nx] != none) {
+              unite(band.parent, id, prev_row[nx]);
+            }
+          }
+        }
+      }
+      if (y == band.y0) {
+        band.first_row = row;
+      }
+      prev_row.swap(row);
+    }
+    band.last_row = prev_row;
+  });
+
+  // translate to global ids
+  std::vector<size_t> parent;
+  std::vector<unsigned int> cells;
+  std::vector<bool> touches_reachable;
+  for (auto& band : bands) {
+    size_t offset = parent.size();
+    for (size_t id : band.parent) {
+      parent.push_back(id + offset);
+    }
+    for (auto* row : {&band.first_row, &band.last_row}) {
+      for (auto& id : *row) {
+        if (id != none) {
+          id += offset;
+        }
+      }
+    }
+    cells.insert(cells.end(), band.cells.begin(), band.cells.end());
+    touches_reachable.insert(touches_reachable.end(),
+                             band.touches_reachable.begin(),
+                             band.touches_reachable.end());
+  }
+
+  // join frontiers over band seams
+  for (size_t b = 1; b < bands_count; ++b) {
+    const auto& upper = bands[b - 1].last_row;
+    const auto& lower = bands[b].first_row;
+    if (upper.empty() || lower.empty()) {
+      continue;
+    }
+    for (unsigned int x = 0; x < size_x_; ++x) {
+      if (lower[x] == none) {
+        continue;
+      }
+      for (unsigned int nx = x > 0 ? x - 1 : 0; nx <= x + 1 && nx < size_x_;
+           ++nx) {
+        if (upper[nx] != none) {
+          unite(parent, lower[x], upper[nx]);
+        }
+      }
+    }
+  }
+
+  // only frontiers adjacent to reachable region are valid
+  std::vector<size_t> roots(parent.size());
+  std::vector<bool> valid(parent.size(), false);
+  for (size_t i = 0; i < parent.size(); ++i) {
+    roots[i] = find(parent, i);
+    if (touches_reachable[i]) {
+      valid[roots[i]] = true;
+    }
+  }
+
+  // first cell of each frontier (the root) becomes the initial cell
+  std::vector<size_t> root_cluster(parent.size(), none);
+  for (size_t i = 0; i < parent.size(); ++i) {
+    if (roots[i] != i || !valid[i]) {
+      continue;
+    }
+    root_cluster[i] = clusters_.size();
+    clusters_.emplace_back();
+    Frontier& output = clusters_.back().frontier;
+    output.centroid.x = 0;
+    output.centroid.y = 0;
+    output.size = 0;
+    output.min_distance = std::numeric_limits<double>::infinity();
+    unsigned int ix, iy;
+    grid_.indexToCells(cells[i], ix, iy);
+    grid_.mapToWorld(ix, iy, output.initial.x, output.initial.y);
+  }
+
+  // assign cells to frontiers, in scan order
+  for (size_t i = 0; i < parent.size(); ++i) {
+    size_t id = root_cluster[roots[i]];
+    if (id == none) {
+      continue;
+    }
+    Cluster& cluster = clusters_[id];
+    cluster.cells.push_back(cells[i]);
+    frontier_flag_[cells[i]] = true;
+    cell_cluster_[cells[i]] = id;
+  }
+
+  // compute frontiers statistics
+  parallelFor(clusters_.size(), threads_, [this](size_t id) {
+    Cluster& cluster = clusters_[id];
+    Frontier& output = cluster.frontier;
+    output.size = static_cast<std::uint32_t>(cluster.cells.size());
+    output.points.reserve(cluster.cells.size() - 1);
+    for (size_t i = 0; i < cluster.cells.size(); ++i) {
+      unsigned int mx, my;
+      geometry_msgs::Point point;
+      grid_.indexToCells(cluster.cells[i], mx, my);
+      grid_.mapToWorld(mx, my, point.x, point.y);
+      output.centroid.x += point.x;
+      output.centroid.y += point.y;
+      // initial cell is not part of points
+      if (i > 0) {
+        output.points.push_back(point);
+      }
+    }
+    output.centroid.x /= output.size;
+    output.centroid.y /= output.size;
+  });
+}
+
+bool FrontierSearch::repairDirty()
+{
+  auto expand = [this](const Region& region, unsigned int n) {
+    return Region{region.x0 > n ? region.x0 - n : 0,
+                  region.y0 > n ? region.y0 - n : 0,
+                  std::min(region.xn + n, size_x_),
+                  std::min(region.yn + n, size_y_)};
+  };
+
+  // frontier cells depend on their 4-connected neighbourhood, so cells up to
+  // one cell around region may become (or stop being) frontier cells.
+  // frontiers are 8-connected and could join through such cells, so frontiers
+  // up to two cells around region may change.
+  std::vector<Region> regions;
+  std::vector<Region> changed_regions;
+  std::vector<Region> affected_regions;
+  for (const auto& region : dirty_regions_) {
+    Region clipped = {region.x0, region.y0, std::min(region.xn, size_x_),
+                      std::min(region.yn, size_y_)};
+    if (clipped.x0 >= clipped.xn || clipped.y0 >= clipped.yn) {
+      continue;
+    }
+    regions.push_back(clipped);
+    changed_regions.push_back(expand(clipped, 1));
+    affected_regions.push_back(expand(clipped, 2));
+  }
+
+  // reachable region may split when its cells are no longer free. we can't
+  // handle that locally.
+  for (const auto& region : regions) {
+    for (unsigned int y = region.y0; y < region.yn; ++y) {
+      for (unsigned int x = region.x0; x < region.xn; ++x) {
+        unsigned int idx = grid_.getIndex(x, y);
+        if (reachable_flag_[idx] && map_[idx] != FREE_SPACE) {
+          // reachable region changed, repair is not possible
+          return false;
+        }
+      }
+    }
+  }
+
+  // refresh frontier cells, whole rows are cheap to process
+  for (const auto& region : changed_regions) {
+    findFrontierCells(map_, size_x_, size_y_, region.y0, region.yn,
+                      frontier_cells_.data());
+  }
+
+  // drop all frontiers that might have changed
+  released_.clear();
+  for (const auto& region : affected_regions) {
+    for (unsigned int y = region.y0; y < region.yn; ++y) {
+      for (unsigned int x = region.x0; x < region.xn; ++x) {
+        unsigned int idx = grid_.getIndex(x, y);
+        if (frontier_flag_[idx]) {
+          removeFrontier(cell_cluster_.at(idx), released_);
+        }
+      }
+    }
+  }
+
+  auto has_reachable_nbr = [this](unsigned int idx) {
+    for (unsigned int nbr : nhood4(idx, grid_)) {
+      if (reachable_flag_[nbr]) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // continue breadth first search from newly freed cells
+  bfs_.clear();
+  for (const auto& region : regions) {
+    for (unsigned int y = region.y0; y < region.yn; ++y) {
+      for (unsigned int x = region.x0; x < region.xn; ++x) {
+        unsigned int idx = grid_.getIndex(x, y);
+        if (map_[idx] == FREE_SPACE && !reachable_flag_[idx] &&
+            has_reachable_nbr(idx)) {
+          reachable_flag_[idx] = true;
+          bfs_.push(idx);
+        }
+      }
+    }
   }
-  visited_flag[bfs.front()] = true;
+  expandReachable(true);
 
-  while (!bfs.empty()) {
-    unsigned int idx = bfs.front();
-    bfs.pop();
+  // rebuild frontiers from changed cells and cells of dropped frontiers
+  auto try_build = [this, &has_reachable_nbr](unsigned int idx) {
+    if (isNewFrontierCell(idx) && has_reachable_nbr(idx)) {
+      buildNewFrontier(idx);
+    }
+  };
+  for (const auto& region : changed_regions) {
+    for (unsigned int y = region.y0; y < region.yn; ++y) {
+      for (unsigned int x = region.x0; x < region.xn; ++x) {
+        try_build(grid_.getIndex(x, y));
+      }
+    }
+  }
+  for (unsigned int idx : released_) {
+    try_build(idx);
+  }
+
+  return true;
+}
+
+void FrontierSearch::expandReachable(bool build_frontiers)
+{
+  while (!bfs_.empty()) {
+    unsigned int idx = bfs_.front();
+    bfs_.pop();
 
     // iterate over 4-connected neighbourhood
-    for (unsigned nbr : nhood4(idx, *costmap_)) {
+    for (unsigned nbr : nhood4(idx, grid_)) {
       // add to queue all free, unvisited cells, use descending search in case
       // initialized on non-free cell
-      if (map_[nbr] <= map_[idx] && !visited_flag[nbr]) {
-        visited_flag[nbr] = true;
-        bfs.push(nbr);
+      if (map_[nbr] <= map_[idx] && !reachable_flag_[nbr]) {
+        reachable_flag_[nbr] = true;
+        bfs_.push(nbr);
+        // record distance from start if we are expanding from start
+        if (path_distance_ && path_visited_.test(idx)) {
+          path_visited_.set(nbr);
+          distance_[nbr] = distance_[idx] + 1;
+        }
         // check if cell is new frontier cell (unvisited, NO_INFORMATION, free
         // neighbour)
-      } else if (isNewFrontierCell(nbr, frontier_flag)) {
-        frontier_flag[nbr] = true;
-        Frontier new_frontier = buildNewFrontier(nbr, pos, frontier_flag);
-        if (new_frontier.size * costmap_->getResolution() >=
-            min_frontier_size_) {
-          frontier_list.push_back(new_frontier);
-        }
+      } else if (build_frontiers && isNewFrontierCell(nbr)) {
+        buildNewFrontier(nbr);
       }
     }
   }
+}
 
-  // set costs of frontiers
-  for (auto& frontier : frontier_list) {
-    frontier.cost = frontierCost(frontier);
+void FrontierSearch::computePathDistances(unsigned int start)
+{
+  path_visited_.resize(size_x_ * size_y_);
+  distance_.resize(size_x_ * size_y_);
+
+  bfs_.clear();
+  bfs_.push(start);
+  path_visited_.set(start);
+  distance_[start] = 0;
+  while (!bfs_.empty()) {
+    unsigned int idx = bfs_.front();
+    bfs_.pop();
+
+    for (unsigned nbr : nhood4(idx, grid_)) {
+      if (reachable_flag_[nbr] && !path_visited_.test(nbr)) {
+        path_visited_.set(nbr);
+        distance_[nbr] = distance_[idx] + 1;
+        bfs_.push(nbr);
+      }
+    }
   }
-  std::sort(
-      frontier_list.begin(), frontier_list.end(),
-      [](const Frontier& f1, const Frontier& f2) { return f1.cost < f2.cost; });
-
-  return frontier_list;
 }
 
-Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
-                                          unsigned int reference,
-                                          std::vector<bool>& frontier_flag)
+void FrontierSearch::buildNewFrontier(unsigned int initial_cell)
 {
+  // reuse unused slot if possible
+  size_t id;
+  if (free_clusters_.empty()) {
+    id = clusters_.size();
+    clusters_.emplace_back();
+  } else {
+    id = free_clusters_.back();
+    free_clusters_.pop_back();
+  }
+  Cluster& cluster = clusters_[id];
+
   // initialize frontier structure
-  Frontier output;
+  Frontier& output = cluster.frontier;
+  output = Frontier();
   output.centroid.x = 0;
   output.centroid.y = 0;
   output.size = 1;
@@ -107,33 +555,34 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
 
   // record initial contact point for frontier
   unsigned int ix, iy;
-  costmap_->indexToCells(initial_cell, ix, iy);
-  costmap_->mapToWorld(ix, iy, output.initial.x, output.initial.y);
+  grid_.indexToCells(initial_cell, ix, iy);
+  grid_.mapToWorld(ix, iy, output.initial.x, output.initial.y);
+  output.centroid.x += output.initial.x;
+  output.centroid.y += output.initial.y;
+  frontier_flag_[initial_cell] = true;
+  cell_cluster_[initial_cell] = id;
+  cluster.cells.push_back(initial_cell);
 
   // push initial gridcell onto queue
-  std::queue<unsigned int> bfs;
-  bfs.push(initial_cell);
+  frontier_bfs_.clear();
+  frontier_bfs_.push(initial_cell);
 
-  // cache reference position in world coords
-  unsigned int rx, ry;
-  double reference_x, reference_y;
-  costmap_->indexToCells(reference, rx, ry);
-  costmap_->mapToWorld(rx, ry, reference_x, reference_y);
-
-  while (!bfs.empty()) {
-    unsigned int idx = bfs.front();
-    bfs.pop();
+  while (!frontier_bfs_.empty()) {
+    unsigned int idx = frontier_bfs_.front();
+    frontier_bfs_.pop();
 
     // try adding cells in 8-connected neighborhood to frontier
-    for (unsigned int nbr : nhood8(idx, *costmap_)) {
+    for (unsigned int nbr : nhood8(idx, grid_)) {
       // check if neighbour is a potential frontier cell
-      if (isNewFrontierCell(nbr, frontier_flag)) {
+      if (isNewFrontierCell(nbr)) {
         // mark cell as frontier
-        frontier_flag[nbr] = true;
+        frontier_flag_[nbr] = true;
+        cell_cluster_[nbr] = id;
+        cluster.cells.push_back(nbr);
         unsigned int mx, my;
         double wx, wy;
-        costmap_->indexToCells(nbr, mx, my);
-        costmap_->mapToWorld(mx, my, wx, wy);
+        grid_.indexToCells(nbr, mx, my);
+        grid_.mapToWorld(mx, my, wx, wy);
 
         geometry_msgs::Point point;
         point.x = wx;
@@ -147,18 +596,8 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
         output.centroid.x += wx;
         output.centroid.y += wy;
 
-        // determine frontier's distance from robot, going by closest gridcell
-        // to robot
-        double distance = sqrt(pow((double(reference_x) - double(wx)), 2.0) +
-                               pow((double(reference_y) - double(wy)), 2.0));
-        if (distance < output.min_distance) {
-          output.min_distance = distance;
-          output.middle.x = wx;
-          output.middle.y = wy;
-        }
-
         // add to queue for breadth first search
-        bfs.push(nbr);
+        frontier_bfs_.push(nbr);
       }
     }
   }
@@ -166,32 +605,82 @@ Frontier FrontierSearch::buildNewFrontier(unsigned int initial_cell,
   // average out frontier centroid
   output.centroid.x /= output.size;
   output.centroid.y /= output.size;
-  return output;
 }
 
-bool FrontierSearch::isNewFrontierCell(unsigned int idx,
-                                       const std::vector<bool>& frontier_flag)
+void FrontierSearch::removeFrontier(size_t id,
+                                    std::vector<unsigned int>& released)
 {
-  // check that cell is unknown and not already marked as frontier
-  if (map_[idx] != NO_INFORMATION || frontier_flag[idx]) {
-    return false;
+  Cluster& cluster = clusters_[id];
+  for (unsigned int idx : cluster.cells) {
+    frontier_flag_[idx] = false;
+    cell_cluster_.erase(idx);
+    released.push_back(idx);
   }
+  cluster.cells.clear();
+  cluster.frontier = Frontier();
+  free_clusters_.push_back(id);
+}
 
-  // frontier cells should have at least one cell in 4-connected neighbourhood
-  // that is free
-  for (unsigned int nbr : nhood4(idx, *costmap_)) {
-    if (map_[nbr] == FREE_SPACE) {
-      return true;
+void FrontierSearch::updateDistance(Frontier& frontier,
+                                    const std::vector<unsigned int>& cells,
+                                    unsigned int reference)
+{
+  frontier.min_distance = std::numeric_limits<double>::infinity();
+
+  if (path_distance_) {
+    // frontier is reached through its reachable neighbours, going by
+    // gridcell with the shortest path from robot
+    for (unsigned int idx : cells) {
+      for (unsigned int nbr : nhood4(idx, grid_)) {
+        if (!path_visited_.test(nbr)) {
+          continue;
+        }
+        double distance = (distance_[nbr] + 1) * grid_.resolution;
+        if (distance < frontier.min_distance) {
+          unsigned int mx, my;
+          frontier.min_distance = distance;
+          grid_.indexToCells(idx, mx, my);
+          grid_.mapToWorld(mx, my, frontier.middle.x, frontier.middle.y);
+        }
+      }
     }
+    return;
   }
 
-  return false;
+  // cache reference position in world coords
+  unsigned int rx, ry;
+  double reference_x, reference_y;
+  grid_.indexToCells(reference, rx, ry);
+  grid_.mapToWorld(rx, ry, reference_x, reference_y);
+
+  // determine frontier's distance from robot, going by closest gridcell to
+  // robot
+  for (unsigned int idx : cells) {
+    unsigned int mx, my;
+    double wx, wy;
+    grid_.indexToCells(idx, mx, my);
+    grid_.mapToWorld(mx, my, wx, wy);
+    double distance = sqrt(pow((double(reference_x) - double(wx)), 2.0) +
+                           pow((double(reference_y) - double(wy)), 2.0));
+    if (distance < frontier.min_distance) {
+      frontier.min_distance = distance;
+      frontier.middle.x = wx;
+      frontier.middle.y = wy;
+    }
+  }
+}
+
+bool FrontierSearch::isNewFrontierCell(unsigned int idx)
+{
+  // frontier cells are unknown with at least one free cell in 4-connected
+  // neighbourhood, check that cell is not already marked as frontier
+  return frontier_cells_[idx] && !frontier_flag_[idx];
 }
 
 double FrontierSearch::frontierCost(const Frontier& frontier)
 {
   return (potential_scale_ * frontier.min_distance *
-          costmap_->getResolution()) -
-         (gain_scale_ * frontier.size * costmap_->getResolution());
+          grid_.resolution) -
+         (gain_scale_ * frontier.size * grid_.resolution);
 }
 }
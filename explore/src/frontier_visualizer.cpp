@@ -0,0 +1,263 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/frontier_visualizer.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace explore
+{
+FrontierVisualizer::FrontierVisualizer(ros::NodeHandle& nh,
+                                       const std::string& topic,
+                                       size_t max_points)
+  : max_points_(max_points)
+  , has_pending_(false)
+  , refresh_(false)
+  , shutdown_(false)
+  , next_id_(0)
+{
+  // markers are not latched, new subscribers get all markers in the next
+  // publishing
+  publisher_ = nh.advertise<visualization_msgs::MarkerArray>(
+      topic, 10, [this](const ros::SingleSubscriberPublisher&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh_ = true;
+      });
+  worker_ = std::thread([this]() { run(); });
+}
+
+FrontierVisualizer::~FrontierVisualizer()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  condition_.notify_all();
+  worker_.join();
+}
+
+void FrontierVisualizer::publish(
+    std::vector<frontier_exploration::Frontier>&& frontiers,
+    std::vector<bool>&& blacklisted, const std::string& frame_id)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.frontiers = std::move(frontiers);
+    pending_.blacklisted = std::move(blacklisted);
+    pending_.frame_id = frame_id;
+    has_pending_ = true;
+  }
+  condition_.notify_one();
+}
+
+void FrontierVisualizer::run()
+{
+#if defined(__linux__)
+  // visualization must not compete with planning, lowest priority for this
+  // thread only
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+#endif
+
+  Job job;
+  visualization_msgs::MarkerArray msg;
+  while (true) {
+    bool refresh;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return has_pending_ || shutdown_; });
+      if (shutdown_) {
+        return;
+      }
+      std::swap(job, pending_);
+      has_pending_ = false;
+      refresh = refresh_;
+      refresh_ = false;
+    }
+
+    msg.markers.clear();
+    if (refresh) {
+      // start over, ids of all frontiers will be assigned again
+      visualization_msgs::Marker m;
+      m.header.frame_id = job.frame_id;
+      m.header.stamp = ros::Time::now();
+      m.ns = "frontiers";
+      m.action = visualization_msgs::Marker::DELETEALL;
+      msg.markers.push_back(m);
+      shown_.clear();
+      free_ids_.clear();
+      next_id_ = 0;
+    }
+    buildMarkers(job, msg);
+    if (!msg.markers.empty()) {
+      publisher_.publish(msg);
+    }
+  }
+}
+
+void FrontierVisualizer::buildMarkers(const Job& job,
+                                      visualization_msgs::MarkerArray& msg)
+{
+  std_msgs::ColorRGBA blue;
+  blue.r = 0;
+  blue.g = 0;
+  blue.b = 1.0;
+  blue.a = 1.0;
+  std_msgs::ColorRGBA red;
+  red.r = 1.0;
+  red.g = 0;
+  red.b = 0;
+  red.a = 1.0;
+  std_msgs::ColorRGBA green;
+  green.r = 0;
+  green.g = 1.0;
+  green.b = 0;
+  green.a = 1.0;
+
+  std::vector<visualization_msgs::Marker>& markers = msg.markers;
+  visualization_msgs::Marker m;
+
+  m.header.frame_id = job.frame_id;
+  m.header.stamp = ros::Time::now();
+  m.ns = "frontiers";
+  m.pose.orientation.w = 1.0;
+  // lives forever
+  m.lifetime = ros::Duration(0);
+  m.frame_locked = true;
+
+  for (auto& shown : shown_) {
+    shown.second.seen = false;
+  }
+
+  // weighted frontiers are always sorted
+  const auto& frontiers = job.frontiers;
+  double min_cost = frontiers.empty() ? 0. : frontiers.front().cost;
+
+  m.action = visualization_msgs::Marker::ADD;
+  for (size_t i = 0; i < frontiers.size(); ++i) {
+    const frontier_exploration::Frontier& frontier = frontiers[i];
+    bool blacklisted = i < job.blacklisted.size() && job.blacklisted[i];
+    // scale frontier according to its cost (costier frontiers will be smaller)
+    double scale = std::min(std::abs(min_cost * 0.4 / frontier.cost), 0.5);
+
+    Key key(std::llround(frontier.initial.x * 1000.),
+            std::llround(frontier.initial.y * 1000.));
+    auto it = shown_.find(key);
+    bool added = it == shown_.end();
+    if (added) {
+      Shown shown;
+      if (free_ids_.empty()) {
+        shown.id = next_id_++;
+      } else {
+        shown.id = free_ids_.back();
+        free_ids_.pop_back();
+      }
+      it = shown_.emplace(key, shown).first;
+    } else if (it->second.seen) {
+      // another frontier with the same initial cell, should not happen
+      continue;
+    }
+    Shown& shown = it->second;
+    shown.seen = true;
+
+    bool points_changed = added || shown.size != frontier.size ||
+                          shown.centroid.x != frontier.centroid.x ||
+                          shown.centroid.y != frontier.centroid.y ||
+                          shown.blacklisted != blacklisted;
+    if (points_changed) {
+      m.type = visualization_msgs::Marker::POINTS;
+      m.id = 2 * shown.id;
+      m.pose.position = {};
+      m.scale.x = 0.1;
+      m.scale.y = 0.1;
+      m.scale.z = 0.1;
+      // decimate evenly along the frontier
+      const auto& points = frontier.points;
+      size_t step = 1;
+      if (max_points_ > 0 && points.size() > max_points_) {
+        step = (points.size() + max_points_ - 1) / max_points_;
+      }
+      m.points.clear();
+      for (size_t j = 0; j < points.size(); j += step) {
+        m.points.push_back(points[j]);
+      }
+      m.color = blacklisted ? red : blue;
+      markers.push_back(m);
+      shown.size = frontier.size;
+      shown.centroid = frontier.centroid;
+      shown.blacklisted = blacklisted;
+    }
+
+    // sphere stays at the initial cell, small changes of scale are not
+    // visible
+    if (added || std::abs(shown.scale - scale) > 1e-3) {
+      m.type = visualization_msgs::Marker::SPHERE;
+      m.id = 2 * shown.id + 1;
+      m.pose.position = frontier.initial;
+      m.scale.x = scale;
+      m.scale.y = scale;
+      m.scale.z = scale;
+      m.points.clear();
+      m.color = green;
+      markers.push_back(m);
+      shown.scale = scale;
+    }
+  }
+
+  // delete markers of frontiers which are gone
+  m.action = visualization_msgs::Marker::DELETE;
+  m.points.clear();
+  for (auto it = shown_.begin(); it != shown_.end();) {
+    if (it->second.seen) {
+      ++it;
+      continue;
+    }
+    m.id = 2 * it->second.id;
+    markers.push_back(m);
+    m.id = 2 * it->second.id + 1;
+    markers.push_back(m);
+    free_ids_.push_back(it->second.id);
+    it = shown_.erase(it);
+  }
+}
+
+}  // namespace explore
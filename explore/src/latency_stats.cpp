@@ -0,0 +1,87 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <explore/latency_stats.h>
+
+#include <algorithm>
+
+namespace explore
+{
+LatencyStats::LatencyStats(size_t window) : window_(std::max<size_t>(window, 1))
+{
+}
+
+void LatencyStats::add(const std::string& stage, double seconds)
+{
+  Window& window = stages_[stage];
+  if (window.samples.size() < window_) {
+    window.samples.push_back(seconds);
+  } else {
+    window.samples[window.next] = seconds;
+  }
+  window.next = (window.next + 1) % window_;
+  window.last = seconds;
+}
+
+void LatencyStats::count(const std::string& counter, size_t n)
+{
+  counters_[counter] += n;
+}
+
+std::map<std::string, LatencyStats::Summary> LatencyStats::summaries() const
+{
+  std::map<std::string, Summary> result;
+  std::vector<double> sorted;
+  for (const auto& stage : stages_) {
+    sorted = stage.second.samples;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest-rank percentile
+    auto percentile = [&sorted](double p) {
+      size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size()));
+      return sorted[std::min(rank, sorted.size() - 1)];
+    };
+    Summary& summary = result[stage.first];
+    summary.samples = sorted.size();
+    summary.last = stage.second.last;
+    summary.p50 = percentile(0.5);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.max = sorted.back();
+  }
+  return result;
+}
+
+}  // namespace explore
@@ -0,0 +1,259 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <explore/frontier_search.h>
+#include <explore/grid_view.h>
+
+/* Benchmarks of frontier search on synthetic maps. Pass --map=<file.pgm> to
+ * also benchmark a real map saved by map_server (the robot is placed into the
+ * centre of the map). Use --benchmark_format=json or
+ * --benchmark_out=<file> for machine-readable results. */
+
+using frontier_exploration::FREE_SPACE;
+using frontier_exploration::LETHAL_OBSTACLE;
+using frontier_exploration::NO_INFORMATION;
+
+const double resolution = 0.05;
+
+// grid owning its cells
+struct Grid {
+  std::vector<unsigned char> cells;
+  frontier_exploration::GridView view;
+
+  Grid(unsigned int size_x, unsigned int size_y)
+    : cells(size_t(size_x) * size_y, NO_INFORMATION)
+  {
+    view.data = cells.data();
+    view.size_x = size_x;
+    view.size_y = size_y;
+    view.resolution = resolution;
+  }
+  // view points to cells
+  Grid(const Grid&) = delete;
+  Grid& operator=(const Grid&) = delete;
+
+  unsigned char& at(unsigned int x, unsigned int y)
+  {
+    return cells[view.getIndex(x, y)];
+  }
+};
+
+// partially explored map of rooms, explored region is a disc around the
+// centre of the map
+static std::shared_ptr<Grid> syntheticMap(unsigned int size)
+{
+  std::shared_ptr<Grid> grid(new Grid(size, size));
+  const unsigned int room = 50;
+  auto door = [room](unsigned int i) {
+    return i % room >= room / 3 && i % room < room / 2;
+  };
+  double radius = size / 3.;
+  for (unsigned int y = 0; y < size; ++y) {
+    for (unsigned int x = 0; x < size; ++x) {
+      double dx = x - size / 2., dy = y - size / 2.;
+      if (dx * dx + dy * dy > radius * radius) {
+        continue;
+      }
+      bool wall = (x % room == 0 && !door(y)) || (y % room == 0 && !door(x));
+      grid->at(x, y) = wall ? LETHAL_OBSTACLE : FREE_SPACE;
+    }
+  }
+  return grid;
+}
+
+// loads binary PGM saved by map_server
+static std::shared_ptr<Grid> loadMap(const std::string& file)
+{
+  std::ifstream in(file, std::ios::binary);
+  std::string magic;
+  unsigned int values[3];
+  in >> magic;
+  for (auto& value : values) {
+    // skip comments
+    while (in >> std::ws && in.peek() == '#') {
+      in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    in >> value;
+  }
+  in.get();
+  if (!in || magic != "P5" || values[2] > 255) {
+    return nullptr;
+  }
+
+  unsigned int width = values[0], height = values[1];
+  std::vector<unsigned char> pixels(size_t(width) * height);
+  in.read(reinterpret_cast<char*>(pixels.data()),
+          std::streamsize(pixels.size()));
+  if (!in) {
+    return nullptr;
+  }
+  std::shared_ptr<Grid> grid(new Grid(width, height));
+  for (unsigned int y = 0; y < height; ++y) {
+    for (unsigned int x = 0; x < width; ++x) {
+      // image rows go from top, map rows from bottom
+      unsigned char pixel = pixels[size_t(height - 1 - y) * width + x];
+      if (pixel < 100) {
+        grid->at(x, y) = LETHAL_OBSTACLE;
+      } else if (pixel > 210) {
+        grid->at(x, y) = FREE_SPACE;
+      }
+    }
+  }
+  return grid;
+}
+
+static geometry_msgs::Point centre(const frontier_exploration::GridView& grid)
+{
+  geometry_msgs::Point position;
+  position.x = grid.size_x * grid.resolution / 2.;
+  position.y = grid.size_y * grid.resolution / 2.;
+  return position;
+}
+
+// searching the whole map
+static void searchFull(benchmark::State& state,
+                       const std::shared_ptr<Grid>& grid,
+                       unsigned int threads, bool path_distance)
+{
+  frontier_exploration::FrontierSearch search(1e-3, 1.0, 0.5, false, threads,
+                                              path_distance);
+  geometry_msgs::Point position = centre(grid->view);
+  size_t frontiers = 0;
+  for (auto _ : state) {
+    frontiers = search.searchFrom(grid->view, position).size();
+  }
+  state.counters["frontiers"] = double(frontiers);
+  state.SetItemsProcessed(int64_t(state.iterations()) * grid->cells.size());
+}
+
+// repairing frontiers after a small part of the map changed
+static void searchIncremental(benchmark::State& state,
+                              const std::shared_ptr<Grid>& grid)
+{
+  frontier_exploration::FrontierSearch search(1e-3, 1.0, 0.5, true, 1, false);
+  geometry_msgs::Point position = centre(grid->view);
+  search.searchFrom(grid->view, position);
+  unsigned int x = grid->view.size_x / 2;
+  unsigned int y = grid->view.size_y / 2;
+  for (auto _ : state) {
+    search.markDirty(x, y, x + 64, y + 64);
+    benchmark::DoNotOptimize(search.searchFrom(grid->view, position));
+  }
+  state.counters["full"] = search.lastStatistics().full;
+}
+
+static void BM_SearchFull(benchmark::State& state)
+{
+  auto grid = syntheticMap(static_cast<unsigned int>(state.range(0)));
+  searchFull(state, grid, static_cast<unsigned int>(state.range(1)), false);
+}
+BENCHMARK(BM_SearchFull)
+    ->ArgNames({"size", "threads"})
+    ->Args({512, 1})
+    ->Args({2048, 1})
+    ->Args({2048, 4})
+    ->Args({4096, 1})
+    ->Args({4096, 4})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SearchPathDistance(benchmark::State& state)
+{
+  auto grid = syntheticMap(static_cast<unsigned int>(state.range(0)));
+  searchFull(state, grid, 1, true);
+}
+BENCHMARK(BM_SearchPathDistance)
+    ->ArgNames({"size"})
+    ->Arg(2048)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SearchIncremental(benchmark::State& state)
+{
+  auto grid = syntheticMap(static_cast<unsigned int>(state.range(0)));
+  searchIncremental(state, grid);
+}
+BENCHMARK(BM_SearchIncremental)
+    ->ArgNames({"size"})
+    ->Arg(2048)
+    ->Arg(4096)
+    ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv)
+{
+  benchmark::Initialize(&argc, argv);
+
+  // remaining arguments are ours
+  std::shared_ptr<Grid> real_map;
+  const std::string map_flag = "--map=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, map_flag.size(), map_flag) != 0) {
+      continue;
+    }
+    real_map = loadMap(arg.substr(map_flag.size()));
+    if (!real_map) {
+      std::cerr << "could not load map " << arg.substr(map_flag.size())
+                << std::endl;
+      return 1;
+    }
+  }
+  if (real_map) {
+    benchmark::RegisterBenchmark(
+        "BM_SearchFullRealMap",
+        [real_map](benchmark::State& state) {
+          searchFull(state, real_map, 1, false);
+        })
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark(
+        "BM_SearchIncrementalRealMap",
+        [real_map](benchmark::State& state) {
+          searchIncremental(state, real_map);
+        })
+        ->Unit(benchmark::kMicrosecond);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <explore/cost_translation.h>
+
+// occupancy value to costmap_2d cost, as defined by the translation table
+static unsigned char expectedCost(unsigned char value)
+{
+  switch (value) {
+    case 0:
+      return 0;  // NO obstacle
+    case 99:
+      return 253;  // INSCRIBED obstacle
+    case 100:
+      return 254;  // LETHAL obstacle
+    case 255:
+      return 255;  // UNKNOWN
+    default:
+      // lineary mapped from [0..100] to [0..255]
+      return static_cast<unsigned char>(1 + (251 * (size_t(value) - 1)) / 97);
+  }
+}
+
+TEST(CostTranslation, implementations)
+{
+  std::vector<std::string> names = explore::costTranslationImplementations();
+  ASSERT_FALSE(names.empty());
+  EXPECT_EQ(names.front(), explore::costTranslationImplementation());
+  EXPECT_EQ(names.back(), "scalar");
+
+  std::int8_t data[4] = {};
+  unsigned char costs[4] = {};
+  EXPECT_FALSE(explore::translateCosts("unknown", data, 4, costs));
+}
+
+TEST(CostTranslation, matchTable)
+{
+  std::mt19937 rng(42);
+  // all byte values in order, valid occupancy values only, so vectors are
+  // not sent to the table, and random values
+  std::vector<std::vector<unsigned char>> inputs(3);
+  for (unsigned int i = 0; i < 256; ++i) {
+    inputs[0].push_back(static_cast<unsigned char>(i));
+  }
+  for (unsigned int i = 0; i < 1024; ++i) {
+    inputs[1].push_back(i % 102 == 101 ? 255 :
+                                         static_cast<unsigned char>(i % 102));
+  }
+  for (unsigned int i = 0; i < 1024; ++i) {
+    inputs[2].push_back(static_cast<unsigned char>(rng()));
+  }
+
+  for (const std::string& implementation :
+       explore::costTranslationImplementations()) {
+    SCOPED_TRACE("implementation " + implementation);
+    for (size_t input = 0; input < inputs.size(); ++input) {
+      const std::vector<unsigned char>& values = inputs[input];
+      // unaligned starts and lengths not divisible by vector size exercise
+      // the scalar tail
+      for (size_t offset : {0, 1, 3, 7, 15}) {
+        for (size_t n : {0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 200}) {
+          if (offset + n > values.size()) {
+            continue;
+          }
+          SCOPED_TRACE("input " + std::to_string(input) + ", offset " +
+                       std::to_string(offset) + ", length " +
+                       std::to_string(n));
+          // output is unaligned as well, cells around it must be kept
+          std::vector<unsigned char> costs(n + 2, 42);
+          ASSERT_TRUE(explore::translateCosts(
+              implementation,
+              reinterpret_cast<const std::int8_t*>(values.data() + offset), n,
+              costs.data() + 1));
+          EXPECT_EQ(costs.front(), 42);
+          EXPECT_EQ(costs.back(), 42);
+          for (size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(int(costs[i + 1]), int(expectedCost(values[offset + i])))
+                << "value " << int(values[offset + i]);
+          }
+        }
+      }
+      // the whole input at once
+      std::vector<unsigned char> costs(values.size());
+      ASSERT_TRUE(explore::translateCosts(
+          implementation, reinterpret_cast<const std::int8_t*>(values.data()),
+          values.size(), costs.data()));
+      for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(int(costs[i]), int(expectedCost(values[i])))
+            << "value " << int(values[i]);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <explore/frontier_blacklist.h>
+
+static geometry_msgs::Point point(double x, double y)
+{
+  geometry_msgs::Point p;
+  p.x = x;
+  p.y = y;
+  return p;
+}
+
+TEST(FrontierBlacklist, tolerance)
+{
+  explore::FrontierBlacklist blacklist(0.5);
+  ros::Time now(100);
+  blacklist.add(point(1., 1.), now);
+  EXPECT_TRUE(blacklist.contains(point(1., 1.), now));
+  // goals across cells of the grid hash
+  EXPECT_TRUE(blacklist.contains(point(1.4, 0.6), now));
+  EXPECT_TRUE(blacklist.contains(point(0.51, 1.49), now));
+  EXPECT_FALSE(blacklist.contains(point(1.5, 1.), now));
+  EXPECT_FALSE(blacklist.contains(point(1., 0.4), now));
+
+  // rehashed goals are still found
+  blacklist.setTolerance(0.1);
+  EXPECT_TRUE(blacklist.contains(point(1.05, 1.), now));
+  EXPECT_FALSE(blacklist.contains(point(1.4, 0.6), now));
+  blacklist.setTolerance(2.);
+  EXPECT_TRUE(blacklist.contains(point(-0.9, 2.9), now));
+}
+
+TEST(FrontierBlacklist, expiry)
+{
+  explore::FrontierBlacklist blacklist(0.5, ros::Duration(10.));
+  blacklist.add(point(0., 0.), ros::Time(100.));
+  blacklist.add(point(0., 0.), ros::Time(101.));
+  // the same goal is stored once
+  EXPECT_EQ(blacklist.size(), 1u);
+  blacklist.add(point(5., 5.), ros::Time(105.));
+  EXPECT_EQ(blacklist.size(), 2u);
+
+  EXPECT_TRUE(blacklist.contains(point(0., 0.), ros::Time(110.)));
+  // expired goals are not contained even before they are removed
+  EXPECT_FALSE(blacklist.contains(point(0., 0.), ros::Time(111.)));
+  EXPECT_TRUE(blacklist.contains(point(5., 5.), ros::Time(111.)));
+  blacklist.removeExpired(ros::Time(111.));
+  EXPECT_EQ(blacklist.size(), 1u);
+  blacklist.removeExpired(ros::Time(116.));
+  EXPECT_EQ(blacklist.size(), 0u);
+  EXPECT_FALSE(blacklist.contains(point(5., 5.), ros::Time(116.)));
+
+  // without timeout goals are kept
+  explore::FrontierBlacklist forever(0.5, ros::Duration(0.), 0);
+  forever.add(point(0., 0.), ros::Time(100.));
+  forever.removeExpired(ros::Time(1e6));
+  EXPECT_TRUE(forever.contains(point(0., 0.), ros::Time(1e6)));
+}
+
+TEST(FrontierBlacklist, maxSize)
+{
+  explore::FrontierBlacklist blacklist(0.5, ros::Duration(0.), 3);
+  for (int i = 0; i < 10; ++i) {
+    // some goals share cells of the grid hash
+    blacklist.add(point(i * 0.2, 0.), ros::Time(100. + i));
+    EXPECT_LE(blacklist.size(), 3u);
+  }
+  // the oldest goals are evicted
+  EXPECT_FALSE(blacklist.contains(point(-0.2, 0.), ros::Time(200.)));
+  EXPECT_FALSE(blacklist.contains(point(0.8, 0.), ros::Time(200.)));
+  EXPECT_TRUE(blacklist.contains(point(1.4, 0.), ros::Time(200.)));
+  EXPECT_TRUE(blacklist.contains(point(1.8, 0.), ros::Time(200.)));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
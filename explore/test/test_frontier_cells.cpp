@@ -0,0 +1,147 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <explore/frontier_cells.h>
+#include <explore/grid_view.h>
+
+using frontier_exploration::FREE_SPACE;
+using frontier_exploration::LETHAL_OBSTACLE;
+using frontier_exploration::NO_INFORMATION;
+
+// straightforward definition of frontier cell
+static unsigned char isFrontierCell(const std::vector<unsigned char>& map,
+                                    unsigned int size_x, unsigned int size_y,
+                                    unsigned int x, unsigned int y)
+{
+  auto at = [&](unsigned int cx, unsigned int cy) {
+    return map[size_t(cy) * size_x + cx];
+  };
+  if (at(x, y) != NO_INFORMATION) {
+    return 0;
+  }
+  bool has_free = (x > 0 && at(x - 1, y) == FREE_SPACE) ||
+                  (x + 1 < size_x && at(x + 1, y) == FREE_SPACE) ||
+                  (y > 0 && at(x, y - 1) == FREE_SPACE) ||
+                  (y + 1 < size_y && at(x, y + 1) == FREE_SPACE);
+  return has_free ? 1 : 0;
+}
+
+TEST(FrontierCells, implementations)
+{
+  std::vector<std::string> names =
+      frontier_exploration::frontierCellsImplementations();
+  ASSERT_FALSE(names.empty());
+  EXPECT_EQ(names.front(), frontier_exploration::frontierCellsImplementation());
+  EXPECT_EQ(names.back(), "scalar");
+
+  unsigned char map[9] = {}, mask[9] = {};
+  EXPECT_FALSE(frontier_exploration::findFrontierCells("unknown", map, 3, 3, 0,
+                                                       3, mask));
+}
+
+TEST(FrontierCells, matchDefinition)
+{
+  std::mt19937 rng(42);
+  // other cells must not be frontier cells nor count as free neighbours
+  const unsigned char others[] = {LETHAL_OBSTACLE, 1, 128, 253};
+  std::vector<std::pair<unsigned int, unsigned int>> sizes = {
+      {1, 1}, {2, 2}, {3, 3}, {1, 50}, {50, 1}, {17, 5}, {33, 9}, {100, 37},
+  };
+  for (int i = 0; i < 30; ++i) {
+    sizes.emplace_back(1 + rng() % 300, 1 + rng() % 30);
+  }
+
+  for (const std::string& implementation :
+       frontier_exploration::frontierCellsImplementations()) {
+    SCOPED_TRACE("implementation " + implementation);
+    for (const auto& size : sizes) {
+      unsigned int size_x = size.first, size_y = size.second;
+      SCOPED_TRACE("size " + std::to_string(size_x) + "x" +
+                   std::to_string(size_y));
+      std::vector<unsigned char> map(size_t(size_x) * size_y);
+      // mostly free and unknown cells, so there are many frontier cells
+      for (auto& cell : map) {
+        unsigned int kind = rng() % 12;
+        if (kind < 4) {
+          cell = FREE_SPACE;
+        } else if (kind < 8) {
+          cell = NO_INFORMATION;
+        } else {
+          cell = others[kind - 8];
+        }
+      }
+
+      std::vector<unsigned char> expected(map.size());
+      for (unsigned int y = 0; y < size_y; ++y) {
+        for (unsigned int x = 0; x < size_x; ++x) {
+          expected[size_t(y) * size_x + x] =
+              isFrontierCell(map, size_x, size_y, x, y);
+        }
+      }
+
+      // the whole map and a band of rows, rows outside the band are kept
+      std::vector<unsigned char> mask(map.size(), 2);
+      ASSERT_TRUE(frontier_exploration::findFrontierCells(
+          implementation, map.data(), size_x, size_y, 0, size_y, mask.data()));
+      ASSERT_EQ(mask, expected);
+
+      unsigned int y0 = rng() % size_y;
+      unsigned int yn = y0 + rng() % (size_y - y0 + 1);
+      std::fill(mask.begin(), mask.end(), 2);
+      ASSERT_TRUE(frontier_exploration::findFrontierCells(
+          implementation, map.data(), size_x, size_y, y0, yn, mask.data()));
+      for (size_t i = 0; i < mask.size(); ++i) {
+        size_t y = i / size_x;
+        ASSERT_EQ(mask[i], y >= y0 && y < yn ? expected[i] : 2)
+          << "cell " << i;
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,355 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <explore/frontier_allocator.h>
+#include <explore/frontier_search.h>
+#include <explore/grid_view.h>
+
+using frontier_exploration::FREE_SPACE;
+using frontier_exploration::LETHAL_OBSTACLE;
+using frontier_exploration::NO_INFORMATION;
+using frontier_exploration::Frontier;
+using frontier_exploration::FrontierSearch;
+
+// grid owning its cells
+struct Grid {
+  std::vector<unsigned char> cells;
+  frontier_exploration::GridView view;
+
+  Grid(unsigned int size_x, unsigned int size_y, double resolution)
+    : cells(size_t(size_x) * size_y, NO_INFORMATION)
+  {
+    view.data = cells.data();
+    view.size_x = size_x;
+    view.size_y = size_y;
+    view.resolution = resolution;
+  }
+  // view points to cells
+  Grid(const Grid&) = delete;
+  Grid& operator=(const Grid&) = delete;
+
+  // fills rectangle [x0, x0 + w) x [y0, y0 + h), clipped by the grid
+  void fill(unsigned int x0, unsigned int y0, unsigned int w, unsigned int h,
+            unsigned char value)
+  {
+    for (unsigned int y = y0; y < std::min(view.size_y, y0 + h); ++y) {
+      for (unsigned int x = x0; x < std::min(view.size_x, x0 + w); ++x) {
+        cells[view.getIndex(x, y)] = value;
+      }
+    }
+  }
+};
+
+static geometry_msgs::Point point(double x, double y)
+{
+  geometry_msgs::Point p;
+  p.x = x;
+  p.y = y;
+  return p;
+}
+
+// frontiers are compared regardless of their order and the order of their
+// cells, centroids may differ by rounding
+static ::testing::AssertionResult
+sameFrontiers(std::vector<Frontier> frontiers, std::vector<Frontier> expected)
+{
+  auto less = [](const Frontier& a, const Frontier& b) {
+    return std::tie(a.size, a.centroid.x, a.centroid.y) <
+           std::tie(b.size, b.centroid.x, b.centroid.y);
+  };
+  std::sort(frontiers.begin(), frontiers.end(), less);
+  std::sort(expected.begin(), expected.end(), less);
+  if (frontiers.size() != expected.size()) {
+    return ::testing::AssertionFailure() << frontiers.size()
+                                         << " frontiers, expected "
+                                         << expected.size();
+  }
+  const double eps = 1e-9;
+  for (size_t i = 0; i < frontiers.size(); ++i) {
+    const Frontier& f = frontiers[i];
+    const Frontier& e = expected[i];
+    if (f.size != e.size || std::fabs(f.centroid.x - e.centroid.x) > eps ||
+        std::fabs(f.centroid.y - e.centroid.y) > eps ||
+        std::fabs(f.min_distance - e.min_distance) > eps) {
+      return ::testing::AssertionFailure()
+             << "frontier of size " << f.size << " at [" << f.centroid.x
+             << ", " << f.centroid.y << "], distance " << f.min_distance
+             << ", expected size " << e.size << " at [" << e.centroid.x
+             << ", " << e.centroid.y << "], distance " << e.min_distance;
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+// explored rectangle in the middle of the map with random obstacles and holes
+static void randomMap(std::mt19937& rng, Grid& grid)
+{
+  unsigned int size_x = grid.view.size_x, size_y = grid.view.size_y;
+  grid.fill(size_x / 4, size_y / 4, size_x / 2, size_y / 2, FREE_SPACE);
+  for (int i = 0; i < 5; ++i) {
+    unsigned char value = NO_INFORMATION;
+    if (rng() % 3 == 0) {
+      value = LETHAL_OBSTACLE;
+    } else if (rng() % 2) {
+      value = FREE_SPACE;
+    }
+    unsigned int x0 = rng() % size_x, y0 = rng() % size_y;
+    unsigned int w = 1 + rng() % 8, h = 1 + rng() % 8;
+    grid.fill(x0, y0, w, h, value);
+  }
+  grid.fill(size_x / 2, size_y / 2, 1, 1, FREE_SPACE);
+}
+
+TEST(FrontierSearch, incrementalMatchesFull)
+{
+  std::mt19937 rng(42);
+  int repaired = 0;
+  for (int trial = 0; trial < 100; ++trial) {
+    Grid grid(20 + rng() % 60, 20 + rng() % 60, 0.05);
+    randomMap(rng, grid);
+    unsigned int size_x = grid.view.size_x, size_y = grid.view.size_y;
+    geometry_msgs::Point robot = point(size_x * 0.05 / 2, size_y * 0.05 / 2);
+    bool path_distance = trial % 2;
+    FrontierSearch incremental(1e-3, 1.0, 0.0, true, 1, path_distance);
+    incremental.searchFrom(grid.view, robot);
+
+    for (int step = 0; step < 20; ++step) {
+      // mostly explore, sometimes add obstacles or forget parts of the map
+      unsigned int x0 = rng() % size_x, y0 = rng() % size_y;
+      unsigned int w = 1 + rng() % 6, h = 1 + rng() % 6;
+      unsigned int kind = rng() % 10;
+      unsigned char value = FREE_SPACE;
+      if (kind >= 8) {
+        value = NO_INFORMATION;
+      } else if (kind >= 6) {
+        value = LETHAL_OBSTACLE;
+      }
+      grid.fill(x0, y0, w, h, value);
+      incremental.markDirty(x0, y0, std::min(size_x, x0 + w),
+                            std::min(size_y, y0 + h));
+
+      FrontierSearch full(1e-3, 1.0, 0.0, false, 1, path_distance);
+      std::vector<Frontier> expected = full.searchFrom(grid.view, robot);
+      std::vector<Frontier> frontiers =
+          incremental.searchFrom(grid.view, robot);
+      ASSERT_TRUE(sameFrontiers(frontiers, expected))
+          << "trial " << trial << ", step " << step;
+      repaired += !incremental.lastStatistics().full;
+    }
+  }
+  // most edits can be repaired without searching the whole map
+  EXPECT_GT(repaired, 1000);
+}
+
+TEST(FrontierSearch, parallelMatchesSerial)
+{
+  std::mt19937 rng(42);
+  for (int trial = 0; trial < 100; ++trial) {
+    Grid grid(20 + rng() % 200, 20 + rng() % 200, 0.05);
+    randomMap(rng, grid);
+    geometry_msgs::Point robot =
+        point(grid.view.size_x * 0.05 / 2, grid.view.size_y * 0.05 / 2);
+    bool path_distance = trial % 2;
+
+    FrontierSearch serial(1e-3, 1.0, 0.0, false, 1, path_distance);
+    std::vector<Frontier> expected = serial.searchFrom(grid.view, robot);
+    for (unsigned int threads : {2u, 3u, 8u}) {
+      FrontierSearch parallel(1e-3, 1.0, 0.0, false, threads, path_distance);
+      std::vector<Frontier> frontiers = parallel.searchFrom(grid.view, robot);
+      ASSERT_TRUE(sameFrontiers(frontiers, expected))
+          << "trial " << trial << ", threads " << threads;
+    }
+  }
+}
+
+TEST(FrontierSearch, pathDistance)
+{
+  // frontier is the last column, behind a wall with a gap in the last row
+  Grid grid(21, 11, 1.0);
+  grid.fill(0, 0, 20, 11, FREE_SPACE);
+  grid.fill(10, 0, 1, 10, LETHAL_OBSTACLE);
+  geometry_msgs::Point robot = point(9.5, 0.5);
+
+  FrontierSearch straight(1.0, 0.0, 0.0, false, 1, false);
+  std::vector<Frontier> frontiers = straight.searchFrom(grid.view, robot);
+  ASSERT_EQ(frontiers.size(), 1u);
+  EXPECT_EQ(frontiers[0].size, 11u);
+  EXPECT_DOUBLE_EQ(frontiers[0].min_distance, 11.);
+
+  FrontierSearch path(1.0, 0.0, 0.0, false, 1, true);
+  frontiers = path.searchFrom(grid.view, robot);
+  ASSERT_EQ(frontiers.size(), 1u);
+  EXPECT_DOUBLE_EQ(frontiers[0].min_distance, 21.);
+  // middle is the frontier cell closest by path
+  EXPECT_DOUBLE_EQ(frontiers[0].middle.x, 20.5);
+  EXPECT_DOUBLE_EQ(frontiers[0].middle.y, 10.5);
+}
+
+TEST(FrontierSearch, searchResult)
+{
+  Grid grid(10, 10, 1.0);
+  FrontierSearch search(1.0, 1.0, 0.0, true, 1, false);
+  EXPECT_TRUE(search.searchFrom(grid.view, point(-1., 5.)).empty());
+  EXPECT_EQ(search.lastStatistics().result,
+            frontier_exploration::SearchResult::OUT_OF_BOUNDS);
+  EXPECT_TRUE(search.searchFrom(grid.view, point(5., 5.)).empty());
+  EXPECT_EQ(search.lastStatistics().result,
+            frontier_exploration::SearchResult::NO_FREE_CELL);
+
+  grid.fill(0, 0, 5, 10, FREE_SPACE);
+  search.markAllDirty();
+  EXPECT_EQ(search.searchFrom(grid.view, point(5., 5.)).size(), 1u);
+  EXPECT_EQ(search.lastStatistics().result,
+            frontier_exploration::SearchResult::FOUND);
+  EXPECT_TRUE(search.lastStatistics().full);
+  // nothing changed, previous frontiers are reused
+  EXPECT_EQ(search.searchFrom(grid.view, point(2., 5.)).size(), 1u);
+  EXPECT_FALSE(search.lastStatistics().full);
+}
+
+// assigns as many rows as possible with minimal cost by trying all
+// assignments
+static void bruteForceAssignment(const std::vector<std::vector<double>>& costs,
+                                 size_t row, std::vector<bool>& used,
+                                 int assigned, double cost, int& best_assigned,
+                                 double& best_cost)
+{
+  if (row == costs.size()) {
+    if (assigned > best_assigned ||
+        (assigned == best_assigned && cost < best_cost)) {
+      best_assigned = assigned;
+      best_cost = cost;
+    }
+    return;
+  }
+  bruteForceAssignment(costs, row + 1, used, assigned, cost, best_assigned,
+                       best_cost);
+  for (size_t col = 0; col < costs[row].size(); ++col) {
+    if (used[col] || !std::isfinite(costs[row][col])) {
+      continue;
+    }
+    used[col] = true;
+    bruteForceAssignment(costs, row + 1, used, assigned + 1,
+                         cost + costs[row][col], best_assigned, best_cost);
+    used[col] = false;
+  }
+}
+
+TEST(AssignMinCost, matchesBruteForce)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  std::mt19937 rng(42);
+  for (int trial = 0; trial < 2000; ++trial) {
+    size_t rows = 1 + rng() % 5, cols = 1 + rng() % 5;
+    std::vector<std::vector<double>> costs(rows, std::vector<double>(cols));
+    for (auto& row : costs) {
+      for (auto& cost : row) {
+        cost = rng() % 4 == 0 ? inf : double(int(rng() % 40) - 20);
+      }
+    }
+
+    std::vector<int> assignment = frontier_exploration::assignMinCost(costs);
+    ASSERT_EQ(assignment.size(), rows);
+    std::vector<bool> used(cols, false);
+    int assigned = 0;
+    double cost = 0.;
+    for (size_t row = 0; row < rows; ++row) {
+      int col = assignment[row];
+      if (col < 0) {
+        continue;
+      }
+      ASSERT_LT(size_t(col), cols);
+      ASSERT_FALSE(used[size_t(col)]) << "column assigned twice";
+      ASSERT_TRUE(std::isfinite(costs[row][size_t(col)]));
+      used[size_t(col)] = true;
+      ++assigned;
+      cost += costs[row][size_t(col)];
+    }
+
+    int best_assigned = -1;
+    double best_cost = 0.;
+    used.assign(cols, false);
+    bruteForceAssignment(costs, 0, used, 0, 0., best_assigned, best_cost);
+    ASSERT_EQ(assigned, best_assigned) << "trial " << trial;
+    ASSERT_DOUBLE_EQ(cost, best_cost) << "trial " << trial;
+  }
+}
+
+TEST(FrontierAllocator, allocate)
+{
+  // corridor with frontiers at both ends, rows 0-2, and isolated corridor
+  // without frontiers, row 4
+  Grid grid(30, 5, 1.0);
+  grid.fill(1, 0, 28, 3, FREE_SPACE);
+  grid.fill(0, 3, 30, 2, LETHAL_OBSTACLE);
+  grid.fill(1, 4, 28, 1, FREE_SPACE);
+
+  FrontierSearch search(1.0, 0.0, 0.0, false, 1, false);
+  std::vector<Frontier> frontiers = search.searchFrom(grid.view, point(15, 1));
+  ASSERT_EQ(frontiers.size(), 2u);
+  size_t left = frontiers[0].centroid.x < frontiers[1].centroid.x ? 0 : 1;
+  size_t right = 1 - left;
+
+  frontier_exploration::FrontierAllocator allocator(1.0, 0.0);
+  // both robots are closer to the right frontier
+  std::vector<geometry_msgs::Point> robots = {point(20.5, 1.5),
+                                              point(24.5, 1.5),
+                                              point(15.5, 4.5)};
+  std::vector<std::vector<size_t>> allocation =
+      allocator.allocate(grid.view, frontiers, robots);
+  ASSERT_EQ(allocation.size(), 3u);
+  // minimal total cost sends the closer robot to the right frontier, the
+  // other one gets the right frontier only as the last option
+  EXPECT_EQ(allocation[0], std::vector<size_t>({left, right}));
+  EXPECT_EQ(allocation[1], std::vector<size_t>({right, left}));
+  EXPECT_TRUE(allocation[2].empty());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <explore/latency_stats.h>
+
+TEST(LatencyStats, percentiles)
+{
+  explore::LatencyStats stats(100);
+  EXPECT_TRUE(stats.summaries().empty());
+  // only the last 100 samples are kept
+  for (int i = 200; i > 0; --i) {
+    stats.add("search", i);
+  }
+  stats.add("plan", 0.5);
+
+  auto summaries = stats.summaries();
+  ASSERT_EQ(summaries.size(), 2u);
+  const explore::LatencyStats::Summary& search = summaries["search"];
+  EXPECT_EQ(search.samples, 100u);
+  EXPECT_EQ(search.last, 1.);
+  EXPECT_EQ(search.p50, 51.);
+  EXPECT_EQ(search.p95, 96.);
+  EXPECT_EQ(search.p99, 100.);
+  EXPECT_EQ(search.max, 100.);
+  const explore::LatencyStats::Summary& plan = summaries["plan"];
+  EXPECT_EQ(plan.samples, 1u);
+  EXPECT_EQ(plan.p50, 0.5);
+  EXPECT_EQ(plan.max, 0.5);
+}
+
+TEST(LatencyStats, counters)
+{
+  explore::LatencyStats stats;
+  stats.count("goals");
+  stats.count("goals", 2);
+  stats.count("goals_blacklisted");
+  EXPECT_EQ(stats.counters().at("goals"), 3u);
+  EXPECT_EQ(stats.counters().at("goals_blacklisted"), 1u);
+  EXPECT_EQ(stats.counters().size(), 2u);
+}
+
+TEST(LatencyStats, scopedTimer)
+{
+  explore::LatencyStats stats;
+  {
+    explore::ScopedTimer timer(stats, "scope");
+  }
+  auto summaries = stats.summaries();
+  ASSERT_EQ(summaries.count("scope"), 1u);
+  EXPECT_EQ(summaries["scope"].samples, 1u);
+  EXPECT_GE(summaries["scope"].last, 0.);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -50,6 +50,31 @@ class GridCompositor
 public:
   nav_msgs::OccupancyGrid::Ptr compose(const std::vector<cv::Mat>& grids,
                                        const std::vector<cv::Rect>& rois);
+
+  /**
+   * @brief Composes part of the result directly from unwarped grids
+   * @details Cells are sampled by the nearest neighbour from grids and
+   * composed into result, warped grids are never stored. Grids shifted only
+   * by translation are composed by plain copying.
+   *
+   * @param grids grids to compose, CV_8U views of occupancy data
+   * @param transforms 3x3 CV_64F transforms mapping coordinates of the result
+   * to cells of appropriate grid, as used by MergingPipeline
+   * @param rois positions of warped grids, as computed by GridWarper
+   * @param dst_roi position of the result, in the same coordinates as rois
+   * @param region part of the result to compose, in the same coordinates as
+   * rois
+   * @param result composed grid of type CV_8S and size of dst_roi
+   */
+  void compose(const std::vector<cv::Mat>& grids,
+               const std::vector<cv::Mat>& transforms,
+               const std::vector<cv::Rect>& rois, const cv::Rect& dst_roi,
+               const cv::Rect& region, cv::Mat& result);
+
+  /**
+   * @brief Computes position of the composed grid
+   */
+  cv::Rect resultRoi(const std::vector<cv::Rect>& rois);
 };
 
 }  // namespace internal
@@ -49,8 +49,29 @@ public:
   cv::Rect warp(const cv::Mat& grid, const cv::Mat& transform,
                 cv::Mat& warped_grid);
 
+  /**
+   * @brief Position of the grid warped by transform, the same as returned by
+   * warp(), without warping the grid
+   */
+  cv::Rect warpedRoi(const cv::Mat& grid, const cv::Mat& transform);
+
+  /**
+   * @brief Bounding box of region of the grid warped by transform
+   * @details Covers all cells of the warped grid sampled from the region.
+   *
+   * @param transform the same transform as used by warp()
+   * @param region part of the grid, in grid cells
+   * @return region in the same coordinates as roi returned by warp()
+   */
+  cv::Rect warpedRegion(const cv::Mat& transform, const cv::Rect& region);
+
 private:
-  cv::Rect warpRoi(const cv::Mat& grid, const cv::Mat& transform);
+  // position of the grid warped by inverse transform H, in closed form
+  cv::Rect warpRoi(const cv::Mat& grid, const cv::Matx23d& H);
+  // warps tiles covering region of warped_grid, returns covered region
+  cv::Rect warpTiles(const cv::Mat& grid, const cv::Matx23d& H,
+                     const cv::Rect& roi, const cv::Rect& region,
+                     cv::Mat& warped_grid);
 };
 
 }  // namespace internal
@@ -37,17 +37,31 @@
 #ifndef MERGING_PIPELINE_H_
 #define MERGING_PIPELINE_H_
 
+#include <algorithm>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include <geometry_msgs/Transform.h>
 #include <nav_msgs/OccupancyGrid.h>
 
 #include <opencv2/core/utility.hpp>
+#include <opencv2/stitching/detail/matchers.hpp>
 
 namespace combine_grids
 {
 enum class FeatureType { AKAZE, ORB, SURF };
 
+/**
+ * @brief Pairs of grids matched during estimation
+ */
+enum class MatchingPolicy {
+  ALL_PAIRS,  ///< match all pairs of grids
+  /// match only pairs confirmed by previous estimation and pairs connecting
+  /// grids not merged together yet
+  CONFIRMED_PAIRS
+};
+
 /**
  * @brief Pipeline for merging overlapping occupancy grids
  * @details Pipeline works on internally stored grids.
@@ -57,18 +71,177 @@ class MergingPipeline
 public:
   template <typename InputIt>
   void feed(InputIt grids_begin, InputIt grids_end);
+  /**
+   * @brief Declares that the grid fed at index differs from the grid
+   * previously fed at the same index only in region
+   * @details Grids fed as different objects are considered completely
+   * changed, grids fed as the same object are considered unchanged. This
+   * allows composeGrids() to compose only the changed part. Must be
+   * called after feed(). It does nothing if the number of grids changed.
+   *
+   * @param index position of the grid in the fed sequence
+   * @param region changed part of the grid, in grid cells
+   */
+  void setChangedRegion(size_t index, const cv::Rect& region);
+  /**
+   * @brief Estimates transforms between fed grids
+   * @details Features and pairwise matches of grids unchanged since the
+   * previous estimation are reused, only changed grids are processed again.
+   */
   bool estimateTransforms(FeatureType feature = FeatureType::AKAZE,
                           double confidence = 1.0);
+  /**
+   * @brief Sets pairs of grids matched by estimateTransforms()
+   * @details Pairs are matched in parallel. With
+   * MatchingPolicy::CONFIRMED_PAIRS, grids merged together by previous
+   * estimation are matched only with grids they have been matched with, so
+   * number of matched pairs grows linearly with the number of grids once they
+   * are merged. Policy is applied only if the number of grids does not change.
+   */
+  void setMatchingPolicy(MatchingPolicy policy)
+  {
+    matching_policy_ = policy;
+  }
+  /**
+   * @brief Sets number of levels of coarse-to-fine estimation
+   * @details With levels > 0, features are found in grids downsampled by
+   * 2^levels preserving occupied cells. Translations of estimated transforms
+   * are then refined at full resolution by aligning occupied cells in a
+   * window of 2^levels cells. 0 estimates at full resolution.
+   */
+  void setPyramidLevels(int levels)
+  {
+    pyramid_levels_ = std::max(0, levels);
+  }
+  /**
+   * @brief Limits size of the composed grid
+   * @details Grids are added to the composed grid starting with the reference
+   * grid. Grids that would make the composed grid wider or higher than size
+   * are left out, so a single bad transform can't make the composed grid
+   * arbitrarily large.
+   *
+   * @param size maximal width and height of the composed grid in cells, 0 for
+   * unlimited size
+   */
+  void setMaxMergedSize(int size)
+  {
+    max_merged_size_ = std::max(0, size);
+  }
+  /**
+   * @brief Finds features using OpenCV transparent API (OpenCL)
+   * @details Features are found on OpenCL device if OpenCV has been built
+   * with OpenCL support and a device is available, otherwise features are
+   * found on CPU as usual. Matching, estimation and compositing always run
+   * on CPU; compositing is bound by memory and the composed grid has to end
+   * up in host memory anyway.
+   */
+  void setUseOpenCL(bool use_opencl)
+  {
+    use_opencl_ = use_opencl;
+  }
+  /**
+   * @brief Refines transforms found by previous estimation
+   * @details Much cheaper than estimateTransforms(). Grids are only shifted
+   * by at most window cells to align their occupied cells with the grids
+   * aligned before. Fails if the number of grids changed, if some grid has
+   * not been estimated yet, or if grids no longer agree with their
+   * transforms. Transforms are left unchanged on failure and
+   * estimateTransforms() should be used instead.
+   *
+   * @param window maximal shift of a grid in cells
+   * @param min_agreement minimal ratio of occupied cells of each grid that
+   * must fall onto occupied cells of other grids
+   * @return true if transforms were tracked
+   */
+  bool trackTransforms(int window = 2, double min_agreement = 0.3);
+
   nav_msgs::OccupancyGrid::Ptr composeGrids();
+  /**
+   * @brief Parts of the grid composed by the last composeGrids() call changed
+   * since the previous call
+   * @details Regions are in cells of the composed grid. The whole grid is
+   * reported when the composed grid changed its size or position.
+   */
+  const std::vector<cv::Rect>& getChangedRegions() const
+  {
+    return changed_merged_regions_;
+  }
 
   std::vector<geometry_msgs::Transform> getTransforms() const;
   template <typename InputIt>
   bool setTransforms(InputIt transforms_begin, InputIt transforms_end);
 
 private:
+  // position of grid composed by previous composeGrids() call. Grids are
+  // sampled directly into the composed grid, warped images are not stored.
+  struct WarpedGrid {
+    cv::Mat transform;  // transform used for warping, empty if not composed
+    cv::Size size;      // size of the grid before warping
+    cv::Rect roi;
+  };
+
+  // features found in grid by previous estimateTransforms() call
+  struct GridFeatures {
+    // keeps grid alive, so its address can't be reused by another grid
+    nav_msgs::OccupancyGrid::ConstPtr grid;
+    cv::detail::ImageFeatures features;
+    // grid was changed in place since features were found
+    bool stale;
+  };
+  typedef std::pair<const nav_msgs::OccupancyGrid*,
+                    const nav_msgs::OccupancyGrid*>
+      GridPair;
+
   std::vector<nav_msgs::OccupancyGrid::ConstPtr> grids_;
   std::vector<cv::Mat> images_;
   std::vector<cv::Mat> transforms_;
+
+  /* state kept between estimateTransforms() calls */
+  std::vector<GridFeatures> features_;
+  FeatureType features_type_ = FeatureType::AKAZE;
+  int features_levels_ = 0;
+  int pyramid_levels_ = 0;
+  bool use_opencl_ = false;
+  // matches between grids from features_, keyed by source and destination
+  std::map<GridPair, cv::detail::MatchesInfo> matches_;
+  MatchingPolicy matching_policy_ = MatchingPolicy::ALL_PAIRS;
+  // pairs of grids (by index) matched with enough confidence
+  cv::Mat_<uchar> confirmed_;
+
+  // grids that fit into composed grid of max_merged_size_
+  std::vector<bool> fittingGrids();
+  // aligns occupied cells of grids with the reference grid by shifting
+  // transforms at most window cells. returns the lowest ratio of occupied
+  // cells of a grid agreeing with grids aligned before it.
+  double refineTranslations(int window);
+  // matches features of grids, reusing matches of grids not recomputed
+  void matchFeatures(cv::detail::FeaturesMatcher& matcher,
+                     const std::vector<cv::detail::ImageFeatures>& features,
+                     const std::vector<bool>& recomputed, double confidence,
+                     std::vector<cv::detail::MatchesInfo>& pairwise_matches);
+
+  /* state kept between composeGrids() calls */
+  std::vector<WarpedGrid> warped_;
+  // grids changed completely since the last composeGrids() by previous feeds
+  std::vector<bool> replaced_;
+  // grids changed completely by the last feed
+  std::vector<bool> fed_replaced_;
+  // changed regions of grids, in grid cells
+  std::vector<cv::Rect> changed_regions_;
+  bool grids_count_changed_ = false;
+  int max_merged_size_ = 0;
+  // composed grid and its position
+  cv::Mat merged_;
+  cv::Rect merged_roi_;
+  // changes of the composed grid made by the last composeGrids()
+  std::vector<cv::Rect> changed_merged_regions_;
+  // buffers reused by composeGrids() calls, they keep their capacity
+  std::vector<cv::Mat> composed_images_;
+  std::vector<cv::Mat> composed_transforms_;
+  std::vector<cv::Rect> composed_rois_;
+  std::vector<cv::Rect> changed_;
+  // result of the last composeGrids(), reused when not held by anyone else
+  nav_msgs::OccupancyGrid::Ptr result_;
 };
 
 template <typename InputIt>
@@ -81,8 +254,9 @@ void MergingPipeline::feed(InputIt grids_begin, InputIt grids_end)
 
   // we can't reserve anything, because we want to support just InputIt and
   // their guarantee validity for only single-pass algos
+  decltype(grids_) previous_grids;
+  std::swap(previous_grids, grids_);
   images_.clear();
-  grids_.clear();
   for (InputIt it = grids_begin; it != grids_end; ++it) {
     if (*it && !(*it)->data.empty()) {
       grids_.push_back(*it);
@@ -95,6 +269,18 @@ void MergingPipeline::feed(InputIt grids_begin, InputIt grids_end)
       images_.emplace_back();
     }
   }
+
+  // grids are matched to the previous grids by position, which is
+  // meaningless when the number of grids changes
+  grids_count_changed_ = previous_grids.size() != grids_.size();
+  replaced_.resize(grids_.size(), true);
+  fed_replaced_.resize(grids_.size(), true);
+  changed_regions_.resize(grids_.size());
+  for (size_t i = 0; i < grids_.size(); ++i) {
+    replaced_[i] = replaced_[i] || fed_replaced_[i] || grids_count_changed_;
+    fed_replaced_[i] =
+        i >= previous_grids.size() || grids_[i] != previous_grids[i];
+  }
 }
 
 template <typename InputIt>
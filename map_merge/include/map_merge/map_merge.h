@@ -39,27 +39,49 @@
 #define MAP_MERGE_H_
 
 #include <atomic>
+#include <condition_variable>
 #include <forward_list>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <combine_grids/merging_pipeline.h>
 #include <geometry_msgs/Pose.h>
+#include <map_merge/snapshot.h>
+#include <map_merge/tiled_grid.h>
 #include <map_msgs/OccupancyGridUpdate.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <ros/ros.h>
+#include <std_msgs/String.h>
 #include <boost/thread.hpp>
 
 namespace map_merge
 {
 struct MapSubscription {
-  // protects consistency of writable_map and readonly_map
-  // also protects reads and writes of shared_ptrs
+  // protects map and its changes
   std::mutex mutex;
 
   geometry_msgs::Transform initial_pose;
-  nav_msgs::OccupancyGrid::Ptr writable_map;
-  nav_msgs::OccupancyGrid::ConstPtr readonly_map;
+  // last full map with partial updates applied
+  TiledGrid map;
+  // incremented on each change of map
+  size_t version = 0;
+  // changes since map was last fed to the merging pipeline
+  bool map_replaced = true;
+  cv::Rect changed_region;
+
+  // contiguous grid fed to the merging pipeline. Accessed only when feeding
+  // the pipeline, not protected by mutex.
+  nav_msgs::OccupancyGrid::ConstPtr fed_map;
+  // fed_map if it is owned by the subscription and can be updated in place
+  nav_msgs::OccupancyGrid::Ptr fed_writable_map;
+
+  // grid used by estimation and version of map it was made from. Accessed
+  // only by estimation, not protected by mutex.
+  nav_msgs::OccupancyGrid::ConstPtr estimation_map;
+  size_t estimation_version = 0;
 
   ros::Subscriber map_sub;
   ros::Subscriber map_updates_sub;
@@ -72,30 +94,122 @@ private:
 
   /* parameters */
   double merging_rate_;
+  double min_merging_rate_;
   double discovery_rate_;
   double estimation_rate_;
   double confidence_threshold_;
+  bool estimation_tracking_;
   std::string robot_map_topic_;
   std::string robot_map_updates_topic_;
   std::string robot_namespace_;
   std::string world_frame_;
   bool have_initial_poses_;
+  ros::Duration full_map_interval_;
+  std::string snapshot_file_;
+  double snapshot_interval_;
+  // robots given by parameter or announced
+  std::vector<std::string> robot_names_;
+  bool discover_topics_;
 
   // publishing
   ros::Publisher merged_map_publisher_;
+  ros::Publisher merged_map_updates_publisher_;
+  // last published full merged map
+  nav_msgs::MapMetaData last_full_map_info_;
+  ros::Time last_full_map_time_;
+  // the current merged map, sent to new subscribers. Empty while merging.
+  nav_msgs::OccupancyGrid::ConstPtr merged_map_;
+  std::mutex merged_map_mutex_;
+  // subscribed while merging, the next merge publishes the full map
+  std::atomic<bool> full_map_requested_{false};
+  // discovery
+  ros::Subscriber robot_announce_sub_;
+  // protects robots_, robot_names_ and seen_topics_
+  std::mutex discovery_mutex_;
+  // topics already inspected by discovery, they are never parsed again
+  std::unordered_set<std::string> seen_topics_;
   // maps robots namespaces to maps. does not own
   std::unordered_map<std::string, MapSubscription*> robots_;
   // owns maps -- iterator safe
   std::forward_list<MapSubscription> subscriptions_;
   size_t subscriptions_size_;
   boost::shared_mutex subscriptions_mutex_;
+  // pipelines are owned by merging and estimation threads respectively
   combine_grids::MergingPipeline pipeline_;
-  std::mutex pipeline_mutex_;
+  combine_grids::MergingPipeline estimation_pipeline_;
+  // transforms from the last estimation, handed over to merging. Accessed
+  // only by atomic operations.
+  typedef std::unordered_map<const MapSubscription*, geometry_msgs::Transform>
+      EstimatedTransforms;
+  std::shared_ptr<const EstimatedTransforms> estimated_transforms_;
+  // number of robots in the last estimation
+  size_t estimated_robots_ = 0;
+  // wakes up merging when maps or transforms change
+  std::mutex changes_mutex_;
+  std::condition_variable changes_condition_;
+  size_t changes_version_ = 0;
+  // wakes up snapshot writing on shutdown
+  std::mutex snapshot_mutex_;
+  std::condition_variable snapshot_condition_;
 
   std::string robotNameFromTopic(const std::string& topic);
   bool isRobotMapTopic(const ros::master::TopicInfo& topic);
   bool getInitPose(const std::string& name, geometry_msgs::Transform& pose);
 
+  /**
+   * @brief Subscribes to maps of robot
+   * @details Fails if initial pose of the robot is needed, but not available.
+   *
+   * @param robot_name namespace of the robot
+   * @return true if robot was added
+   */
+  bool addRobot(const std::string& robot_name);
+  void robotAnnounced(const std_msgs::String::ConstPtr& msg);
+
+  /**
+   * @brief Restores robots, their maps and transforms from snapshot
+   * @details Robots are subscribed as if they were discovered. Merged map is
+   * available immediately, estimation starts from restored transforms.
+   */
+  void restoreSnapshot();
+  /**
+   * @brief Writes maps and transforms of all robots to snapshot
+   */
+  void writeSnapshot();
+
+  /**
+   * @brief Feeds current maps of all robots to the merging pipeline
+   * @details Changes of maps since the last feed are passed to the pipeline.
+   * Transforms are set to initial poses or to the last estimated transforms.
+   */
+  void feedPipeline();
+
+  /**
+   * @brief Notifies merging about changed maps or transforms
+   */
+  void notifyChange();
+
+  /**
+   * @brief Waits until maps or transforms change since version
+   * @details Waits at most 1 / min_merging_rate_ if set. Returns immediately
+   * on shutdown.
+   *
+   * @param version last version seen by the caller, updated to the current
+   * version
+   */
+  void waitForChange(size_t& version);
+
+  /**
+   * @brief Sends the current merged map to the new subscriber
+   */
+  void mergedMapSubscribed(const ros::SingleSubscriberPublisher& pub);
+
+  /**
+   * @brief Publishes changed regions of the merged map as updates
+   */
+  void publishMapUpdates(const nav_msgs::OccupancyGrid& merged_map,
+                         const std::vector<cv::Rect>& regions);
+
   void fullMapUpdate(const nav_msgs::OccupancyGrid::ConstPtr& msg,
                      MapSubscription& map);
   void partialMapUpdate(const map_msgs::OccupancyGridUpdate::ConstPtr& msg,
@@ -108,6 +222,7 @@ public:
   void executetopicSubscribing();
   void executemapMerging();
   void executeposeEstimation();
+  void executesnapshotWriting();
 
   void topicSubscribing();
   void mapMerging();
@@ -0,0 +1,87 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/Transform.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+namespace map_merge
+{
+/**
+ * @brief State of a single robot stored in the snapshot
+ */
+struct RobotSnapshot {
+  // namespace of the robot
+  std::string name;
+  nav_msgs::OccupancyGrid::ConstPtr map;
+  // transform of the map in the merged map, if it was known
+  bool has_transform = false;
+  geometry_msgs::Transform transform;
+};
+
+/**
+ * @brief Writes maps and transforms of robots to file
+ * @details Occupancy data are run-length encoded, everything else is stored
+ * in ROS serialization format. The file is synced to disk and replaced
+ * atomically, readers never see a partially written snapshot. Snapshots are
+ * not portable between architectures with different endianness.
+ *
+ * @param path file to write
+ * @param robots robots with maps, robots without maps are skipped
+ * @return true on success
+ */
+bool saveSnapshot(const std::string& path,
+                  const std::vector<RobotSnapshot>& robots);
+
+/**
+ * @brief Reads snapshot written by saveSnapshot()
+ *
+ * @param path file to read
+ * @param robots robots stored in the snapshot
+ * @return false if file can't be read or is not a valid snapshot, robots are
+ * left empty in that case
+ */
+bool loadSnapshot(const std::string& path, std::vector<RobotSnapshot>& robots);
+
+}  // namespace map_merge
+
+#endif  // SNAPSHOT_H_
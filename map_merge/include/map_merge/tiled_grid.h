@@ -0,0 +1,140 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef TILED_GRID_H_
+#define TILED_GRID_H_
+
+#include <memory>
+#include <vector>
+
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include <opencv2/core/types.hpp>
+
+namespace map_merge
+{
+/**
+ * @brief Occupancy grid stored in tiles shared copy-on-write between copies
+ * @details Grid starts as a full map message, which is referenced and not
+ * copied. Tiles touched by partial updates are copied from the message on the
+ * first write. Copying TiledGrid is cheap and produces a consistent snapshot:
+ * tiles are shared and a tile shared with other copies is cloned before it is
+ * written. Copies must be made under the same lock as writes, but they can be
+ * read and destroyed concurrently with writes to the original.
+ */
+class TiledGrid
+{
+public:
+  /// tiles are squares of tile_size cells, except tiles on the grid border
+  constexpr static int tile_size = 64;
+
+  /**
+   * @brief Replaces content of grid by the full map
+   * @details Map data are not copied.
+   */
+  void reset(const nav_msgs::OccupancyGrid::ConstPtr& map);
+
+  /**
+   * @brief Writes cells of partial update into the grid
+   * @details Only tiles touched by the update and shared with other copies
+   * are copied. Parts of the update not fitting into the grid are ignored.
+   *
+   * @param update update with data of size at least width * height
+   * @return updated region of the grid in cells, empty if update does not
+   * intersect the grid
+   */
+  cv::Rect update(const map_msgs::OccupancyGridUpdate& update);
+
+  /**
+   * @brief Copies region of grid into contiguous grid of the same size
+   */
+  void copyTo(const cv::Rect& region, nav_msgs::OccupancyGrid& grid) const;
+
+  /**
+   * @brief Contiguous copy of the whole grid
+   */
+  nav_msgs::OccupancyGrid::Ptr copy() const;
+
+  /**
+   * @brief Full map this grid was reset to
+   */
+  const nav_msgs::OccupancyGrid::ConstPtr& base() const
+  {
+    return base_;
+  }
+
+  /**
+   * @brief Whether some cells differ from base()
+   */
+  bool modified() const
+  {
+    return modified_;
+  }
+
+  bool empty() const
+  {
+    return !base_;
+  }
+
+  /**
+   * @brief Time stamp of the last full map or partial update
+   */
+  const ros::Time& stamp() const
+  {
+    return stamp_;
+  }
+
+private:
+  typedef std::vector<int8_t> Tile;
+
+  cv::Rect tileRect(size_t tile_x, size_t tile_y) const;
+  Tile& writableTile(size_t tile_x, size_t tile_y);
+
+  nav_msgs::OccupancyGrid::ConstPtr base_;
+  ros::Time stamp_;
+  int width_ = 0;
+  int height_ = 0;
+  size_t tiles_x_ = 0;
+  size_t tiles_y_ = 0;
+  // tiles in row-major order, null tile has its cells in base_
+  std::vector<std::shared_ptr<Tile>> tiles_;
+  bool modified_ = false;
+};
+
+}  // namespace map_merge
+
+#endif  // TILED_GRID_H_
@@ -40,6 +40,7 @@
 #include <combine_grids/merging_pipeline.h>
 #include <opencv2/core/utility.hpp>
 #include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/stitching/detail/matchers.hpp>
 
 namespace combine_grids
@@ -59,6 +60,41 @@ chooseFeatureFinder(FeatureType type)
   }
 }
 
+/**
+ * @brief Reduces grid by factor preserving occupancy
+ * @details Each cell of the result is occupied if any cell of the block is
+ * occupied, free if any cell is free and unknown otherwise. Grids are CV_8U
+ * views of occupancy data, unknown is 255.
+ */
+static inline cv::Mat downsampleGrid(const cv::Mat& grid, int factor)
+{
+  if (grid.empty() || factor <= 1) {
+    return grid;
+  }
+
+  // order values as unknown < free < occupied, so block maximum keeps the
+  // most important value
+  cv::Mat signed_grid(grid.size(), CV_8S, const_cast<uchar*>(grid.ptr()),
+                      grid.step);
+  cv::Mat ordered;
+  signed_grid.convertTo(ordered, CV_8U, 1, 1);
+  cv::Mat block_max;
+  cv::dilate(ordered, block_max, cv::Mat::ones(factor, factor, CV_8U),
+             cv::Point(0, 0));
+
+  cv::Mat result((grid.rows + factor - 1) / factor,
+                 (grid.cols + factor - 1) / factor, CV_8U);
+  for (int y = 0; y < result.rows; ++y) {
+    const uchar* src = block_max.ptr<uchar>(y * factor);
+    uchar* dst = result.ptr<uchar>(y);
+    for (int x = 0; x < result.cols; ++x) {
+      // back to occupancy values, unknown wraps to 255
+      dst[x] = static_cast<uchar>(src[x * factor] - 1);
+    }
+  }
+  return result;
+}
+
 static inline void writeDebugMatchingInfo(
     const std::vector<cv::Mat>& images,
     const std::vector<cv::detail::ImageFeatures>& image_features,
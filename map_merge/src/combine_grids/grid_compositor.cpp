@@ -36,14 +36,115 @@
 
 #include <combine_grids/grid_compositor.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <opencv2/stitching/detail/util.hpp>
 
 #include <ros/assert.h>
 
+#include "parallel_internal.h"
+
 namespace combine_grids
 {
 namespace internal
 {
+// size of tiles composed in parallel
+constexpr static int tile_size = 256;
+
+// index of the sampled cell, the same computation must be used everywhere
+static inline int sampleIndex(double scale, double offset, int x)
+{
+  return cvFloor(scale * x + offset);
+}
+
+// shrinks [x0, xn) to x for which sampleIndex(scale, offset, x) is in [0, n)
+static void clipRange(double scale, double offset, int n, int& x0, int& xn)
+{
+  auto valid = [=](int x) {
+    int i = sampleIndex(scale, offset, x);
+    return i >= 0 && i < n;
+  };
+  if (scale != 0.) {
+    // solve linear inequalities, result might be off by rounding. start from
+    // slightly larger interval and shrink it by exact checks.
+    double lo = -offset / scale;
+    double hi = (n - offset) / scale;
+    if (scale < 0.) {
+      std::swap(lo, hi);
+    }
+    lo = std::max(lo, double(x0)) - 1.;
+    hi = std::min(hi, double(xn)) + 1.;
+    x0 = std::max(x0, cvFloor(lo));
+    xn = std::min(xn, cvCeil(hi));
+  }
+  while (x0 < xn && !valid(x0)) {
+    ++x0;
+  }
+  while (xn > x0 && !valid(xn - 1)) {
+    --xn;
+  }
+}
+
+// composes cells of grid sampled for overlap (in result coordinates) into
+// result positioned at dst_tl
+static void composeGrid(const cv::Mat& grid, const cv::Mat& transform,
+                        const cv::Rect& overlap, const cv::Point& dst_tl,
+                        cv::Mat& result)
+{
+  ROS_ASSERT(transform.type() == CV_64F && transform.isContinuous());
+  const double* m = transform.ptr<double>();
+  // reinterpret grid as signed. we will not change this matrix, but opencv
+  // does not support const matrices
+  cv::Mat grid_signed(grid.size(), CV_8S, const_cast<uchar*>(grid.ptr()),
+                      grid.step);
+
+  if (m[0] == 1. && m[1] == 0. && m[3] == 0. && m[4] == 1.) {
+    // pure translation (common with known initial poses), grid is only
+    // shifted
+    cv::Point shift(cvFloor(m[2] + 0.5), cvFloor(m[5] + 0.5));
+    cv::Rect grid_rect = (overlap + shift) & cv::Rect(cv::Point(), grid.size());
+    if (grid_rect.area() <= 0) {
+      return;
+    }
+    cv::Mat result_roi(result, grid_rect - shift - dst_tl);
+    cv::Mat grid_roi(grid_signed, grid_rect);
+    cv::max(result_roi, grid_roi, result_roi);
+    return;
+  }
+
+  // general affine transform. resolve grid borders for each row first, so
+  // the inner loop has no branches. indices buffer is kept by each thread
+  // and grows only when needed.
+  static thread_local std::vector<int> indices;
+  if (indices.size() < static_cast<size_t>(overlap.width)) {
+    indices.resize(static_cast<size_t>(overlap.width));
+  }
+  for (int y = overlap.y; y < overlap.br().y; ++y) {
+    // +0.5 rounds to the nearest neighbour
+    double offset_x = m[1] * y + m[2] + 0.5;
+    double offset_y = m[4] * y + m[5] + 0.5;
+    int x0 = overlap.x;
+    int xn = overlap.br().x;
+    clipRange(m[0], offset_x, grid.cols, x0, xn);
+    clipRange(m[3], offset_y, grid.rows, x0, xn);
+    if (x0 >= xn) {
+      continue;
+    }
+
+    int step = static_cast<int>(grid.step);
+    for (int x = x0; x < xn; ++x) {
+      indices[size_t(x - x0)] = sampleIndex(m[3], offset_y, x) * step +
+                                sampleIndex(m[0], offset_x, x);
+    }
+    const schar* src = grid_signed.ptr<schar>();
+    schar* dst = result.ptr<schar>(y - dst_tl.y) + (x0 - dst_tl.x);
+    for (int i = 0; i < xn - x0; ++i) {
+      dst[i] = std::max(dst[i], src[indices[size_t(i)]]);
+    }
+  }
+}
+
 nav_msgs::OccupancyGrid::Ptr GridCompositor::compose(
     const std::vector<cv::Mat>& grids, const std::vector<cv::Rect>& rois)
 {
@@ -51,15 +152,7 @@ nav_msgs::OccupancyGrid::Ptr GridCompositor::compose(
 
   nav_msgs::OccupancyGrid::Ptr result_grid(new nav_msgs::OccupancyGrid());
 
-  std::vector<cv::Point> corners;
-  corners.reserve(grids.size());
-  std::vector<cv::Size> sizes;
-  sizes.reserve(grids.size());
-  for (auto& roi : rois) {
-    corners.push_back(roi.tl());
-    sizes.push_back(roi.size());
-  }
-  cv::Rect dst_roi = cv::detail::resultRoi(corners, sizes);
+  cv::Rect dst_roi = resultRoi(rois);
 
   result_grid->info.width = static_cast<uint>(dst_roi.width);
   result_grid->info.height = static_cast<uint>(dst_roi.height);
@@ -67,20 +160,64 @@ nav_msgs::OccupancyGrid::Ptr GridCompositor::compose(
   // create view for opencv pointing to newly allocated grid
   cv::Mat result(dst_roi.size(), CV_8S, result_grid->data.data());
 
-  for (size_t i = 0; i < grids.size(); ++i) {
-    // we need to compensate global offset
-    cv::Rect roi = cv::Rect(corners[i] - dst_roi.tl(), sizes[i]);
-    cv::Mat result_roi(result, roi);
-    // reinterpret warped matrix as signed
-    // we will not change this matrix, but opencv does not support const matrices
-    cv::Mat warped_signed (grids[i].size(), CV_8S, const_cast<uchar*>(grids[i].ptr()));
-    // compose img into result matrix
-    cv::max(result_roi, warped_signed, result_roi);
+  // warped grids are just shifted to their positions
+  std::vector<cv::Mat> transforms;
+  transforms.reserve(rois.size());
+  for (const auto& roi : rois) {
+    cv::Mat transform = cv::Mat::eye(3, 3, CV_64F);
+    transform.at<double>(0, 2) = -roi.x;
+    transform.at<double>(1, 2) = -roi.y;
+    transforms.push_back(transform);
   }
+  compose(grids, transforms, rois, dst_roi, dst_roi, result);
 
   return result_grid;
 }
 
+void GridCompositor::compose(const std::vector<cv::Mat>& grids,
+                             const std::vector<cv::Mat>& transforms,
+                             const std::vector<cv::Rect>& rois,
+                             const cv::Rect& dst_roi, const cv::Rect& region,
+                             cv::Mat& result)
+{
+  ROS_ASSERT(grids.size() == rois.size());
+  ROS_ASSERT(grids.size() == transforms.size());
+  ROS_ASSERT(result.size() == dst_roi.size());
+
+  cv::Rect update = region & dst_roi;
+  if (update.area() <= 0) {
+    return;
+  }
+
+  // tiles of the result are composed independently
+  std::vector<cv::Rect> tiles = alignedTiles(update - dst_roi.tl(), tile_size);
+  parallelFor(static_cast<int>(tiles.size()), [&](int i) {
+    const cv::Rect& tile = tiles[static_cast<size_t>(i)];
+    cv::Mat(result, tile).setTo(-1);
+    // we need to compensate global offset
+    cv::Rect tile_update = tile + dst_roi.tl();
+    for (size_t j = 0; j < grids.size(); ++j) {
+      cv::Rect overlap = tile_update & rois[j];
+      if (overlap.area() > 0) {
+        composeGrid(grids[j], transforms[j], overlap, dst_roi.tl(), result);
+      }
+    }
+  });
+}
+
+cv::Rect GridCompositor::resultRoi(const std::vector<cv::Rect>& rois)
+{
+  std::vector<cv::Point> corners;
+  corners.reserve(rois.size());
+  std::vector<cv::Size> sizes;
+  sizes.reserve(rois.size());
+  for (auto& roi : rois) {
+    corners.push_back(roi.tl());
+    sizes.push_back(roi.size());
+  }
+  return cv::detail::resultRoi(corners, sizes);
+}
+
 }  // namespace internal
 
 }  // namespace combine_grids
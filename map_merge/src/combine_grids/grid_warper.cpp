@@ -36,48 +36,134 @@
 
 #include <combine_grids/grid_warper.h>
 
-#include <opencv2/stitching/detail/warpers.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
 
 #include <ros/assert.h>
 
+#include "parallel_internal.h"
+
 namespace combine_grids
 {
 namespace internal
 {
+// size of tiles used for warping
+constexpr static int tile_size = 256;
+
 cv::Rect GridWarper::warp(const cv::Mat& grid, const cv::Mat& transform,
                           cv::Mat& warped_grid)
 {
   ROS_ASSERT(transform.type() == CV_64F);
-  cv::Mat H;
+  cv::Matx23d H;
   invertAffineTransform(transform.rowRange(0, 2), H);
   cv::Rect roi = warpRoi(grid, H);
-  // shift top left corner for warp affine (otherwise the image is cropped)
-  H.at<double>(0, 2) -= roi.tl().x;
-  H.at<double>(1, 2) -= roi.tl().y;
-  warpAffine(grid, warped_grid, H, roi.size(), cv::INTER_NEAREST,
-             cv::BORDER_CONSTANT,
-             cv::Scalar::all(255) /* this is -1 for signed char */);
+  warped_grid.create(roi.size(), grid.type());
+  warpTiles(grid, H, roi, cv::Rect(cv::Point(), roi.size()), warped_grid);
   ROS_ASSERT(roi.size() == warped_grid.size());
 
   return roi;
 }
 
-cv::Rect GridWarper::warpRoi(const cv::Mat& grid, const cv::Mat& transform)
+cv::Rect GridWarper::warpedRoi(const cv::Mat& grid, const cv::Mat& transform)
+{
+  ROS_ASSERT(transform.type() == CV_64F);
+  cv::Matx23d H;
+  invertAffineTransform(transform.rowRange(0, 2), H);
+  return warpRoi(grid, H);
+}
+
+cv::Rect GridWarper::warpedRegion(const cv::Mat& transform,
+                                  const cv::Rect& region)
+{
+  ROS_ASSERT(transform.type() == CV_64F);
+  cv::Matx23d H;
+  invertAffineTransform(transform.rowRange(0, 2), H);
+
+  // region is enlarged by one cell, so it covers all warped cells rounded to
+  // the region.
+  std::vector<cv::Point2d> region_corners{
+      {region.x - 1., region.y - 1.},
+      {region.x + region.width + 1., region.y - 1.},
+      {region.x - 1., region.y + region.height + 1.},
+      {region.x + region.width + 1., region.y + region.height + 1.}};
+  std::vector<cv::Point2d> corners;
+  cv::transform(region_corners, corners, H);
+  cv::Point2d tl = corners[0], br = corners[0];
+  for (const auto& corner : corners) {
+    tl.x = std::min(tl.x, corner.x);
+    tl.y = std::min(tl.y, corner.y);
+    br.x = std::max(br.x, corner.x);
+    br.y = std::max(br.y, corner.y);
+  }
+  return cv::Rect(cv::Point(cvFloor(tl.x), cvFloor(tl.y)),
+                  cv::Point(cvCeil(br.x) + 1, cvCeil(br.y) + 1));
+}
+
+cv::Rect GridWarper::warpTiles(const cv::Mat& grid, const cv::Matx23d& H,
+                               const cv::Rect& roi, const cv::Rect& region,
+                               cv::Mat& warped_grid)
+{
+  cv::Rect bounded = region & cv::Rect(cv::Point(), roi.size());
+  if (bounded.area() <= 0) {
+    return cv::Rect();
+  }
+
+  // align to tiles, so results do not depend on the warped region
+  int tiles_x0 = bounded.x / tile_size * tile_size;
+  int tiles_y0 = bounded.y / tile_size * tile_size;
+  int tiles_xn = (bounded.br().x + tile_size - 1) / tile_size * tile_size;
+  int tiles_yn = (bounded.br().y + tile_size - 1) / tile_size * tile_size;
+  cv::Rect covered(cv::Point(tiles_x0, tiles_y0),
+                   cv::Point(std::min(roi.width, tiles_xn),
+                             std::min(roi.height, tiles_yn)));
+  std::vector<cv::Rect> tiles = alignedTiles(covered, tile_size);
+
+  // tiles are written independently
+  parallelFor(static_cast<int>(tiles.size()), [&](int i) {
+    const cv::Rect& tile = tiles[static_cast<size_t>(i)];
+    // shift top left corner for warp affine (otherwise the image is cropped)
+    cv::Matx23d H_tile = H;
+    H_tile(0, 2) -= roi.x + tile.x;
+    H_tile(1, 2) -= roi.y + tile.y;
+    // view of the tile is written in place
+    cv::Mat warped_tile(warped_grid, tile);
+    warpAffine(grid, warped_tile, H_tile, tile.size(), cv::INTER_NEAREST,
+               cv::BORDER_CONSTANT,
+               cv::Scalar::all(255) /* this is -1 for signed char */);
+  });
+
+  return covered;
+}
+
+cv::Rect GridWarper::warpRoi(const cv::Mat& grid, const cv::Matx23d& H)
 {
-  cv::Ptr<cv::detail::PlaneWarper> warper =
-      cv::makePtr<cv::detail::PlaneWarper>();
-  cv::Mat H;
-  transform.convertTo(H, CV_32F);
-
-  // separate rotation and translation for plane warper
-  // 3D translation
-  cv::Mat T = cv::Mat::zeros(3, 1, CV_32F);
-  H.colRange(2, 3).rowRange(0, 2).copyTo(T.rowRange(0, 2));
-  // 3D rotation
-  cv::Mat R = cv::Mat::eye(3, 3, CV_32F);
-  H.colRange(0, 2).copyTo(R.rowRange(0, 2).colRange(0, 2));
-
-  return warper->warpRoi(grid.size(), cv::Mat::eye(3, 3, CV_32F), R, T);
+  // bounding box of warped centres of corner cells. computed in floats and
+  // truncated as cv::detail::PlaneWarper does, so positions of warped grids
+  // do not change.
+  const float h[6] = {float(H(0, 0)), float(H(0, 1)), float(H(0, 2)),
+                      float(H(1, 0)), float(H(1, 1)), float(H(1, 2))};
+  const float xs[2] = {0.f, float(grid.cols - 1)};
+  const float ys[2] = {0.f, float(grid.rows - 1)};
+  float tl_x = std::numeric_limits<float>::max();
+  float tl_y = std::numeric_limits<float>::max();
+  float br_x = -std::numeric_limits<float>::max();
+  float br_y = -std::numeric_limits<float>::max();
+  for (float y : ys) {
+    for (float x : xs) {
+      float u = h[0] * x + h[1] * y + h[2];
+      float v = h[3] * x + h[4] * y + h[5];
+      tl_x = std::min(tl_x, u);
+      tl_y = std::min(tl_y, v);
+      br_x = std::max(br_x, u);
+      br_y = std::max(br_y, v);
+    }
+  }
+  return cv::Rect(cv::Point(static_cast<int>(tl_x), static_cast<int>(tl_y)),
+                  cv::Point(static_cast<int>(br_x) + 1,
+                            static_cast<int>(br_y) + 1));
 }
 
 }  // namespace internal
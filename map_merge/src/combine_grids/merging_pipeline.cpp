@@ -34,14 +34,20 @@
  *
  *********************************************************************/
 
+#include <algorithm>
+
 #include <combine_grids/grid_compositor.h>
 #include <combine_grids/grid_warper.h>
 #include <combine_grids/merging_pipeline.h>
+#include <opencv2/core.hpp>
+#include <opencv2/core/ocl.hpp>
+#include <opencv2/imgproc.hpp>
 #include <ros/assert.h>
 #include <ros/console.h>
 #include <opencv2/stitching/detail/matchers.hpp>
 #include <opencv2/stitching/detail/motion_estimators.hpp>
 #include "estimation_internal.h"
+#include "parallel_internal.h"
 
 namespace combine_grids
 {
@@ -68,22 +74,63 @@ bool MergingPipeline::estimateTransforms(FeatureType feature_type,
 
   /* find features in images */
   ROS_DEBUG("computing features");
+  if (feature_type != features_type_ || pyramid_levels_ != features_levels_) {
+    features_.clear();
+    matches_.clear();
+    features_type_ = feature_type;
+    features_levels_ = pyramid_levels_;
+  }
+  // coarse estimation works on downsampled grids
+  const int factor = 1 << pyramid_levels_;
+  // without OpenCL device UMat would only add copies
+  const bool use_opencl = use_opencl_ && cv::ocl::haveOpenCL();
+  std::vector<cv::Mat> estimation_images(images_.size());
+  // features are reused for grids fed again unchanged
+  std::vector<GridFeatures> features;
+  features.reserve(images_.size());
+  std::vector<bool> recomputed(images_.size(), false);
   image_features.reserve(images_.size());
-  for (const cv::Mat& image : images_) {
-    image_features.emplace_back();
-    if (!image.empty()) {
-      (*finder)(image, image_features.back());
+  for (size_t i = 0; i < images_.size(); ++i) {
+    auto cached = std::find_if(features_.begin(), features_.end(),
+                               [this, i](const GridFeatures& other) {
+                                 return other.grid == grids_[i] &&
+                                        !other.stale;
+                               });
+    if (grids_[i] && cached != features_.end()) {
+      features.push_back(*cached);
+    } else {
+      features.push_back({grids_[i], cv::detail::ImageFeatures(), false});
+      estimation_images[i] = internal::downsampleGrid(images_[i], factor);
+      if (!estimation_images[i].empty()) {
+        if (use_opencl) {
+          // finder runs its OpenCL kernels on UMat input
+          cv::UMat image = estimation_images[i].getUMat(cv::ACCESS_READ);
+          (*finder)(image, features.back().features);
+        } else {
+          (*finder)(estimation_images[i], features.back().features);
+        }
+      }
+      recomputed[i] = true;
     }
+    image_features.push_back(features.back().features);
   }
   finder->collectGarbage();
+  std::swap(features_, features);
 
   /* find corespondent features */
   ROS_DEBUG("pairwise matching features");
-  (*matcher)(image_features, pairwise_matches);
+  matchFeatures(*matcher, image_features, recomputed, confidence,
+                pairwise_matches);
   matcher->collectGarbage();
 
 #ifndef NDEBUG
-  internal::writeDebugMatchingInfo(images_, image_features, pairwise_matches);
+  for (size_t i = 0; i < images_.size(); ++i) {
+    if (estimation_images[i].empty()) {
+      estimation_images[i] = internal::downsampleGrid(images_[i], factor);
+    }
+  }
+  internal::writeDebugMatchingInfo(estimation_images, image_features,
+                                   pairwise_matches);
 #endif
 
   /* use only matches that has enough confidence. leave out matches that are not
@@ -135,9 +182,147 @@ bool MergingPipeline::estimateTransforms(FeatureType feature_type,
     ++i;
   }
 
+  if (factor > 1) {
+    // scale transforms to full resolution: T = S * T_coarse * S^-1
+    cv::Mat S = cv::Mat::eye(3, 3, CV_64F);
+    S.at<double>(0, 0) = S.at<double>(1, 1) = factor;
+    cv::Mat S_inv = S.inv();
+    for (auto& transform : transforms_) {
+      if (!transform.empty()) {
+        transform = S * transform * S_inv;
+      }
+    }
+    ROS_DEBUG("refining transforms at full resolution");
+    refineTranslations(factor);
+  }
+
   return true;
 }
 
+// labels connected components of graph given by adjacency matrix
+static std::vector<int> connectedComponents(const cv::Mat_<uchar>& adjacency)
+{
+  std::vector<int> component(static_cast<size_t>(adjacency.rows), -1);
+  int label = 0;
+  for (int start = 0; start < adjacency.rows; ++start) {
+    if (component[size_t(start)] >= 0) {
+      continue;
+    }
+    std::vector<int> stack{start};
+    component[size_t(start)] = label;
+    while (!stack.empty()) {
+      int i = stack.back();
+      stack.pop_back();
+      for (int j = 0; j < adjacency.cols; ++j) {
+        if (adjacency(i, j) && component[size_t(j)] < 0) {
+          component[size_t(j)] = label;
+          stack.push_back(j);
+        }
+      }
+    }
+    ++label;
+  }
+  return component;
+}
+
+void MergingPipeline::matchFeatures(
+    cv::detail::FeaturesMatcher& matcher,
+    const std::vector<cv::detail::ImageFeatures>& image_features,
+    const std::vector<bool>& recomputed, double confidence,
+    std::vector<cv::detail::MatchesInfo>& pairwise_matches)
+{
+  const int n = static_cast<int>(image_features.size());
+  pairwise_matches.assign(size_t(n * n), cv::detail::MatchesInfo());
+
+  // grids connected by matches confirmed during previous estimation
+  bool pruning = matching_policy_ == MatchingPolicy::CONFIRMED_PAIRS &&
+                 confirmed_.rows == n;
+  std::vector<int> component;
+  if (pruning) {
+    component = connectedComponents(confirmed_);
+  }
+
+  // results for pairs of unchanged grids are reused, other pairs are matched
+  std::vector<std::pair<int, int>> to_match;
+  std::vector<bool> have_match(size_t(n * n), false);
+  for (int i = 0; i < n; ++i) {
+    for (int j = i + 1; j < n; ++j) {
+      // grids given without occupancy grid are never cached
+      GridPair key(grids_[size_t(i)].get(), grids_[size_t(j)].get());
+      GridPair dual_key(key.second, key.first);
+      auto cached = matches_.find(key);
+      auto dual_cached = matches_.find(dual_key);
+      if (!recomputed[size_t(i)] && !recomputed[size_t(j)] &&
+          cached != matches_.end() && dual_cached != matches_.end()) {
+        pairwise_matches[size_t(i * n + j)] = cached->second;
+        pairwise_matches[size_t(j * n + i)] = dual_cached->second;
+      } else if (pruning && component[size_t(i)] == component[size_t(j)] &&
+                 !confirmed_(i, j)) {
+        // grids are already merged through other grids
+        continue;
+      } else if (!image_features[size_t(i)].keypoints.empty() &&
+                 !image_features[size_t(j)].keypoints.empty()) {
+        to_match.emplace_back(i, j);
+      }
+      have_match[size_t(i * n + j)] = have_match[size_t(j * n + i)] = true;
+    }
+  }
+
+  auto match_pair = [&](int k) {
+    int from = to_match[size_t(k)].first;
+    int to = to_match[size_t(k)].second;
+    cv::detail::MatchesInfo& match = pairwise_matches[size_t(from * n + to)];
+    matcher(image_features[size_t(from)], image_features[size_t(to)], match);
+    match.src_img_idx = from;
+    match.dst_img_idx = to;
+
+    cv::detail::MatchesInfo& dual = pairwise_matches[size_t(to * n + from)];
+    dual = match;
+    dual.src_img_idx = to;
+    dual.dst_img_idx = from;
+    if (!match.H.empty()) {
+      dual.H = match.H.inv();
+    }
+    for (auto& dmatch : dual.matches) {
+      std::swap(dmatch.queryIdx, dmatch.trainIdx);
+    }
+  };
+  if (matcher.isThreadSafe()) {
+    internal::parallelFor(static_cast<int>(to_match.size()), match_pair);
+  } else {
+    for (int k = 0; k < static_cast<int>(to_match.size()); ++k) {
+      match_pair(k);
+    }
+  }
+
+  // store results for the next estimation
+  std::map<GridPair, cv::detail::MatchesInfo> matches;
+  confirmed_.create(n, n);
+  confirmed_.setTo(0);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      cv::detail::MatchesInfo& match = pairwise_matches[size_t(i * n + j)];
+      if (!have_match[size_t(i * n + j)]) {
+        continue;
+      }
+      if (match.src_img_idx >= 0) {
+        // grids might have been fed in different order
+        match.src_img_idx = i;
+        match.dst_img_idx = j;
+      }
+      confirmed_(i, j) = match.confidence >= confidence;
+      if (!grids_[size_t(i)] || !grids_[size_t(j)]) {
+        continue;
+      }
+      GridPair key(grids_[size_t(i)].get(), grids_[size_t(j)].get());
+      matches[key] = match;
+      // estimation must not change cached matches
+      matches[key].H = match.H.clone();
+    }
+  }
+  std::swap(matches_, matches);
+}
+
 // checks whether given matrix is an identity, i.e. exactly appropriate Mat::eye
 static inline bool isIdentity(const cv::Mat& matrix)
 {
@@ -148,38 +333,345 @@ static inline bool isIdentity(const cv::Mat& matrix)
   return cv::countNonZero(diff) == 0;
 }
 
+// occupied and free cells of grid in CV_8U view of occupancy data
+static void knownCells(const cv::Mat& image, std::vector<cv::Point>& occupied,
+                       std::vector<cv::Point>& free)
+{
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr<uchar>(y);
+    for (int x = 0; x < image.cols; ++x) {
+      if (row[x] > 50 && row[x] <= 100) {
+        occupied.emplace_back(x, y);
+      } else if (row[x] <= 50) {
+        free.emplace_back(x, y);
+      }
+    }
+  }
+}
+
+double MergingPipeline::refineTranslations(int window)
+{
+  // reference grid's cells are the coordinates of the composed grid
+  size_t reference = transforms_.size();
+  for (size_t i = 0; i < transforms_.size(); ++i) {
+    if (isIdentity(transforms_[i])) {
+      reference = i;
+      break;
+    }
+  }
+  if (reference == transforms_.size()) {
+    return 0.;
+  }
+
+  // area of the composed grid, with margin for shifting
+  internal::GridWarper warper;
+  cv::Rect area;
+  for (size_t i = 0; i < transforms_.size(); ++i) {
+    if (!transforms_[i].empty() && !images_[i].empty()) {
+      cv::Rect roi = warper.warpedRoi(images_[i], transforms_[i]);
+      area = area.area() > 0 ? (area | roi) : roi;
+    }
+  }
+  area.x -= window;
+  area.y -= window;
+  area.width += 2 * window;
+  area.height += 2 * window;
+
+  // cells of grids aligned so far: 0 unknown, 1 free, 2 occupied
+  const uchar free_cell = 1, occupied_cell = 2;
+  cv::Mat_<uchar> aligned(area.size(), uchar(0));
+  cv::Rect bounds(cv::Point(), area.size());
+  auto mark = [&](const std::vector<cv::Point>& cells, uchar value) {
+    for (const auto& p : cells) {
+      if (bounds.contains(p)) {
+        aligned(p) = std::max(aligned(p), value);
+      }
+    }
+  };
+  // maps grid cells to cells of aligned
+  auto to_aligned = [&](const cv::Mat& H, std::vector<cv::Point>& cells) {
+    const double* h = H.ptr<double>();
+    for (auto& cell : cells) {
+      cell = cv::Point(cvRound(h[0] * cell.x + h[1] * cell.y + h[2]) - area.x,
+                       cvRound(h[3] * cell.x + h[4] * cell.y + h[5]) - area.y);
+    }
+  };
+  std::vector<cv::Point> occupied, free;
+  knownCells(images_[reference], occupied, free);
+  cv::Mat H = cv::Mat::eye(2, 3, CV_64F);
+  to_aligned(H, occupied);
+  to_aligned(H, free);
+  mark(free, free_cell);
+  mark(occupied, occupied_cell);
+
+  // align other grids one by one by translation maximizing number of
+  // occupied cells falling onto occupied cells of already aligned grids
+  double agreement = 1.;
+  for (size_t i = 0; i < transforms_.size(); ++i) {
+    if (i == reference || transforms_[i].empty() || images_[i].empty()) {
+      continue;
+    }
+    occupied.clear();
+    free.clear();
+    knownCells(images_[i], occupied, free);
+    cv::invertAffineTransform(transforms_[i].rowRange(0, 2), H);
+    to_aligned(H, occupied);
+    to_aligned(H, free);
+
+    cv::Point best_shift;
+    size_t best_score = 0;
+    for (int dy = -window; dy <= window; ++dy) {
+      for (int dx = -window; dx <= window; ++dx) {
+        cv::Point shift(dx, dy);
+        size_t score = 0;
+        for (const auto& p : occupied) {
+          cv::Point q = p + shift;
+          score += bounds.contains(q) && aligned(q) == occupied_cell;
+        }
+        // prefer estimated position on ties
+        if (score > best_score ||
+            (score == best_score && shift.dot(shift) <
+                                        best_shift.dot(best_shift))) {
+          best_score = score;
+          best_shift = shift;
+        }
+      }
+    }
+
+    // occupied cells overlapping known space of aligned grids should be
+    // occupied in them too
+    size_t overlapping = 0;
+    for (auto& p : occupied) {
+      p += best_shift;
+      overlapping += bounds.contains(p) && aligned(p) != 0;
+    }
+    if (overlapping > 0) {
+      agreement = std::min(agreement, double(best_score) / overlapping);
+    }
+
+    // grid is moved in composed coordinates: T' = T * translation(-shift)
+    cv::Mat translation = cv::Mat::eye(3, 3, CV_64F);
+    translation.at<double>(0, 2) = -best_shift.x;
+    translation.at<double>(1, 2) = -best_shift.y;
+    transforms_[i] = transforms_[i] * translation;
+    for (auto& p : free) {
+      p += best_shift;
+    }
+    mark(free, free_cell);
+    mark(occupied, occupied_cell);
+  }
+
+  return agreement;
+}
+
+bool MergingPipeline::trackTransforms(int window, double min_agreement)
+{
+  // every grid must have been estimated before
+  if (grids_count_changed_ || transforms_.size() != images_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < images_.size(); ++i) {
+    if (!images_[i].empty() && transforms_[i].empty()) {
+      return false;
+    }
+  }
+
+  // transforms are not changed if tracking fails
+  std::vector<cv::Mat> previous;
+  previous.reserve(transforms_.size());
+  for (const auto& transform : transforms_) {
+    previous.push_back(transform.clone());
+  }
+  if (refineTranslations(window) < min_agreement) {
+    ROS_DEBUG("transforms diverged, tracking failed");
+    std::swap(transforms_, previous);
+    return false;
+  }
+
+  return true;
+}
+
+void MergingPipeline::setChangedRegion(size_t index, const cv::Rect& region)
+{
+  if (index >= grids_.size()) {
+    return;
+  }
+  // grid could have been changed in place
+  if (region.area() > 0) {
+    for (auto& features : features_) {
+      if (features.grid == grids_[index]) {
+        features.stale = true;
+      }
+    }
+  }
+  if (grids_count_changed_) {
+    return;
+  }
+  fed_replaced_[index] = false;
+  cv::Rect& changed = changed_regions_[index];
+  changed = changed.area() > 0 ? (changed | region) : region;
+}
+
+// checks whether two transforms are exactly the same
+static inline bool sameTransform(const cv::Mat& a, const cv::Mat& b)
+{
+  if (a.empty() || b.empty()) {
+    return a.empty() && b.empty();
+  }
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::countNonZero(a != b) == 0;
+}
+
+std::vector<bool> MergingPipeline::fittingGrids()
+{
+  std::vector<bool> fitting(images_.size(), true);
+  if (max_merged_size_ <= 0) {
+    return fitting;
+  }
+
+  // start with the reference grid, so outliers are left out, not the grids
+  // they were estimated against
+  std::vector<size_t> order;
+  order.reserve(images_.size());
+  for (size_t i = 0; i < images_.size(); ++i) {
+    if (isIdentity(transforms_[i])) {
+      order.insert(order.begin(), i);
+    } else {
+      order.push_back(i);
+    }
+  }
+
+  internal::GridWarper warper;
+  cv::Rect extent;
+  for (size_t i : order) {
+    if (transforms_[i].empty() || images_[i].empty()) {
+      continue;
+    }
+    cv::Rect roi = warper.warpedRoi(images_[i], transforms_[i]);
+    cv::Rect grown = extent.area() > 0 ? (extent | roi) : roi;
+    if (grown.width > max_merged_size_ || grown.height > max_merged_size_) {
+      ROS_WARN_THROTTLE(10., "grid %zu would make merged grid %dx%d cells "
+                             "large, leaving it out of merged grid",
+                        i, grown.width, grown.height);
+      fitting[i] = false;
+      continue;
+    }
+    extent = grown;
+  }
+
+  return fitting;
+}
+
 nav_msgs::OccupancyGrid::Ptr MergingPipeline::composeGrids()
 {
   ROS_ASSERT(images_.size() == transforms_.size());
   ROS_ASSERT(images_.size() == grids_.size());
 
+  changed_merged_regions_.clear();
   if (images_.empty()) {
     return nullptr;
   }
 
-  ROS_DEBUG("warping grids");
-  internal::GridWarper warper;
-  std::vector<cv::Mat> imgs_warped;
-  imgs_warped.reserve(images_.size());
-  std::vector<cv::Rect> rois;
-  rois.reserve(images_.size());
+  // grids may have been also added directly, without feed()
+  if (replaced_.size() != images_.size()) {
+    replaced_.assign(images_.size(), true);
+    fed_replaced_.assign(images_.size(), true);
+    changed_regions_.assign(images_.size(), cv::Rect());
+  }
+  warped_.resize(images_.size());
 
+  ROS_DEBUG("computing positions of warped grids");
+  internal::GridWarper warper;
+  std::vector<bool> fitting = fittingGrids();
+  // changed parts of the composed grid
+  std::vector<cv::Rect>& changed = changed_;
+  changed.clear();
   for (size_t i = 0; i < images_.size(); ++i) {
-    if (!transforms_[i].empty() && !images_[i].empty()) {
-      imgs_warped.emplace_back();
-      rois.emplace_back(
-          warper.warp(images_[i], transforms_[i], imgs_warped.back()));
+    WarpedGrid& warped = warped_[i];
+    if (transforms_[i].empty() || images_[i].empty() || !fitting[i]) {
+      if (!warped.transform.empty()) {
+        changed.push_back(warped.roi);
+      }
+      warped = WarpedGrid();
+      continue;
+    }
+
+    bool reusable = !warped.transform.empty() && !replaced_[i] &&
+                    !fed_replaced_[i] && warped.size == images_[i].size() &&
+                    sameTransform(warped.transform, transforms_[i]);
+    if (!reusable) {
+      if (!warped.transform.empty()) {
+        changed.push_back(warped.roi);
+      }
+      warped.roi = warper.warpedRoi(images_[i], transforms_[i]);
+      warped.transform = transforms_[i].clone();
+      warped.size = images_[i].size();
+      changed.push_back(warped.roi);
+    } else if (changed_regions_[i].area() > 0) {
+      changed.push_back(
+          warper.warpedRegion(transforms_[i], changed_regions_[i]) &
+          warped.roi);
     }
   }
+  replaced_.assign(images_.size(), false);
+  fed_replaced_.assign(images_.size(), false);
+  changed_regions_.assign(images_.size(), cv::Rect());
 
-  if (imgs_warped.empty()) {
+  std::vector<cv::Mat>& imgs = composed_images_;
+  std::vector<cv::Mat>& transforms = composed_transforms_;
+  std::vector<cv::Rect>& rois = composed_rois_;
+  imgs.clear();
+  transforms.clear();
+  rois.clear();
+  for (size_t i = 0; i < warped_.size(); ++i) {
+    if (!warped_[i].transform.empty()) {
+      imgs.push_back(images_[i]);
+      transforms.push_back(warped_[i].transform);
+      rois.push_back(warped_[i].roi);
+    }
+  }
+
+  if (imgs.empty()) {
+    merged_.release();
     return nullptr;
   }
 
   ROS_DEBUG("compositing result grid");
-  nav_msgs::OccupancyGrid::Ptr result;
   internal::GridCompositor compositor;
-  result = compositor.compose(imgs_warped, rois);
+  cv::Rect dst_roi = compositor.resultRoi(rois);
+  if (merged_.empty() || dst_roi != merged_roi_) {
+    // composed grid changed its size, it must be composed again
+    merged_.create(dst_roi.size(), CV_8S);
+    merged_roi_ = dst_roi;
+    changed.assign(1, dst_roi);
+  }
+  // grids are sampled directly into the composed grid
+  for (const auto& region : changed) {
+    compositor.compose(imgs, transforms, rois, merged_roi_, region, merged_);
+    cv::Rect merged_region = region & merged_roi_;
+    if (merged_region.area() > 0) {
+      changed_merged_regions_.push_back(merged_region - merged_roi_.tl());
+    }
+  }
+
+  // composed grids are not needed anymore, do not keep them alive
+  imgs.clear();
+  transforms.clear();
+
+  // reuse the previous result (and its data buffer) if the caller already
+  // released it
+  if (!result_ || result_.use_count() > 1) {
+    result_.reset(new nav_msgs::OccupancyGrid());
+  } else {
+    result_->header = std_msgs::Header();
+    result_->info = nav_msgs::MapMetaData();
+  }
+  nav_msgs::OccupancyGrid::Ptr result = result_;
+  result->info.width = static_cast<uint>(merged_roi_.width);
+  result->info.height = static_cast<uint>(merged_roi_.height);
+  ROS_ASSERT(merged_.isContinuous());
+  const signed char* merged_data = merged_.ptr<signed char>();
+  result->data.assign(merged_data, merged_data + merged_roi_.area());
 
   // set correct resolution to output grid. use resolution of identity (works
   // for estimated trasforms), or any resolution (works for know_init_positions)
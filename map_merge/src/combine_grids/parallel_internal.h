@@ -0,0 +1,105 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#ifndef PARALLEL_INTERNAL_H_
+#define PARALLEL_INTERNAL_H_
+
+#include <vector>
+
+#include <opencv2/core/utility.hpp>
+
+namespace combine_grids
+{
+namespace internal
+{
+/**
+ * @brief Calls body(i) for each i in [0, n) using OpenCV worker threads
+ * @details Number of workers is controlled by cv::setNumThreads(). Nested
+ * loops are run by the calling thread.
+ */
+template <typename Body>
+void parallelFor(int n, const Body& body)
+{
+  class Loop : public cv::ParallelLoopBody
+  {
+  public:
+    explicit Loop(const Body& body) : body_(body)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+      for (int i = range.start; i < range.end; ++i) {
+        body_(i);
+      }
+    }
+
+  private:
+    const Body& body_;
+  };
+
+  if (n == 1) {
+    body(0);
+  } else if (n > 1) {
+    cv::parallel_for_(cv::Range(0, n), Loop(body));
+  }
+}
+
+/**
+ * @brief Splits region into tiles aligned to multiples of tile_size
+ */
+static inline std::vector<cv::Rect> alignedTiles(const cv::Rect& region,
+                                                 int tile_size)
+{
+  std::vector<cv::Rect> tiles;
+  if (region.area() <= 0) {
+    return tiles;
+  }
+  int x0 = region.x / tile_size * tile_size;
+  int y0 = region.y / tile_size * tile_size;
+  for (int y = y0; y < region.br().y; y += tile_size) {
+    for (int x = x0; x < region.br().x; x += tile_size) {
+      tiles.push_back(cv::Rect(x, y, tile_size, tile_size) & region);
+    }
+  }
+  return tiles;
+}
+
+}  // namespace internal
+
+}  // namespace combine_grids
+
+#endif  // PARALLEL_INTERNAL_H_
@@ -35,9 +35,13 @@
  *
  *********************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <thread>
 
 #include <map_merge/map_merge.h>
+#include <opencv2/core/utility.hpp>
 #include <ros/assert.h>
 #include <ros/console.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
@@ -49,22 +53,79 @@ MapMerge::MapMerge() : subscriptions_size_(0)
   ros::NodeHandle private_nh("~");
   std::string frame_id;
   std::string merged_map_topic;
+  std::string merged_map_updates_topic;
+  std::string robot_announce_topic;
+  double full_map_interval;
+  int merging_threads;
+  bool prune_matches;
+  int pyramid_levels;
+  bool estimation_opencl;
+  int max_merged_map_size;
 
   private_nh.param("merging_rate", merging_rate_, 4.0);
+  private_nh.param("min_merging_rate", min_merging_rate_, 0.0);
   private_nh.param("discovery_rate", discovery_rate_, 0.05);
   private_nh.param("estimation_rate", estimation_rate_, 0.5);
   private_nh.param("known_init_poses", have_initial_poses_, true);
   private_nh.param("estimation_confidence", confidence_threshold_, 1.0);
+  private_nh.param("estimation_prune_matches", prune_matches, false);
+  estimation_pipeline_.setMatchingPolicy(
+      prune_matches ? combine_grids::MatchingPolicy::CONFIRMED_PAIRS
+                    : combine_grids::MatchingPolicy::ALL_PAIRS);
+  private_nh.param("estimation_tracking", estimation_tracking_, false);
+  private_nh.param("estimation_opencl", estimation_opencl, false);
+  estimation_pipeline_.setUseOpenCL(estimation_opencl);
+  private_nh.param("estimation_pyramid_levels", pyramid_levels, 0);
+  estimation_pipeline_.setPyramidLevels(pyramid_levels);
+  private_nh.param("max_merged_map_size", max_merged_map_size, 0);
+  pipeline_.setMaxMergedSize(max_merged_map_size);
   private_nh.param<std::string>("robot_map_topic", robot_map_topic_, "map");
   private_nh.param<std::string>("robot_map_updates_topic",
                                 robot_map_updates_topic_, "map_updates");
   private_nh.param<std::string>("robot_namespace", robot_namespace_, "");
+  private_nh.param("robots", robot_names_, std::vector<std::string>());
+  for (auto& robot_name : robot_names_) {
+    robot_name = ros::names::resolve(robot_name, false);
+  }
+  private_nh.param<std::string>("robot_announce_topic", robot_announce_topic,
+                                "");
+  // master is searched for robots only if robots are not given otherwise
+  discover_topics_ = robot_names_.empty() && robot_announce_topic.empty();
   private_nh.param<std::string>("merged_map_topic", merged_map_topic, "map");
+  private_nh.param<std::string>("merged_map_updates_topic",
+                                merged_map_updates_topic, "map_updates");
+  private_nh.param("full_map_interval", full_map_interval, 0.0);
+  full_map_interval_ = ros::Duration(full_map_interval);
   private_nh.param<std::string>("world_frame", world_frame_, "world");
+  private_nh.param<std::string>("snapshot_file", snapshot_file_, "");
+  private_nh.param("snapshot_interval", snapshot_interval_, 60.0);
+  private_nh.param("merging_threads", merging_threads, 0);
+  if (merging_threads > 0) {
+    // opencv uses all cores by default
+    cv::setNumThreads(merging_threads);
+  }
 
   /* publishing */
-  merged_map_publisher_ =
-      node_.advertise<nav_msgs::OccupancyGrid>(merged_map_topic, 50, true);
+  // latched map may be older than the merged map when only updates are
+  // published, new subscribers get the current one
+  merged_map_publisher_ = node_.advertise<nav_msgs::OccupancyGrid>(
+      merged_map_topic, 50,
+      std::bind(&MapMerge::mergedMapSubscribed, this, std::placeholders::_1),
+      ros::SubscriberStatusCallback(), ros::VoidConstPtr(), true);
+  merged_map_updates_publisher_ =
+      node_.advertise<map_msgs::OccupancyGridUpdate>(merged_map_updates_topic,
+                                                     50);
+
+  /* discovery */
+  if (!robot_announce_topic.empty()) {
+    robot_announce_sub_ = node_.subscribe<std_msgs::String>(
+        robot_announce_topic, 50,
+        [this](const std_msgs::String::ConstPtr& msg) { robotAnnounced(msg); });
+  }
+
+  if (!snapshot_file_.empty()) {
+    restoreSnapshot();
+  }
 }
 
 /*
@@ -74,69 +135,178 @@ void MapMerge::topicSubscribing()
 {
   ROS_DEBUG("Robot discovery started.");
 
-  ros::master::V_TopicInfo topic_infos;
-  geometry_msgs::Transform init_pose;
-  std::string robot_name;
-  std::string map_topic;
-  std::string map_updates_topic;
+  std::lock_guard<std::mutex> lock(discovery_mutex_);
+  // robots given explicitly or announced are retried until they can be added
+  for (const auto& robot_name : robot_names_) {
+    if (!robots_.count(robot_name)) {
+      addRobot(robot_name);
+    }
+  }
+  if (!discover_topics_) {
+    return;
+  }
 
+  ros::master::V_TopicInfo topic_infos;
   ros::master::getTopics(topic_infos);
-  // default msg constructor does no properly initialize quaternion
-  init_pose.rotation.w = 1;  // create identity quaternion
 
   for (const auto& topic : topic_infos) {
+    // each topic is inspected only once, unless its robot could not be added
+    if (seen_topics_.count(topic.name)) {
+      continue;
+    }
     // we check only map topic
     if (!isRobotMapTopic(topic)) {
+      seen_topics_.insert(topic.name);
       continue;
     }
 
-    robot_name = robotNameFromTopic(topic.name);
-    if (robots_.count(robot_name)) {
-      // we already know this robot
-      continue;
+    std::string robot_name = robotNameFromTopic(topic.name);
+    if (robots_.count(robot_name) || addRobot(robot_name)) {
+      seen_topics_.insert(topic.name);
     }
+  }
+}
 
-    if (have_initial_poses_ && !getInitPose(robot_name, init_pose)) {
-      ROS_WARN("Couldn't get initial position for robot [%s]\n"
-               "did you defined parameters map_merge/init_pose_[xyz]? in robot "
-               "namespace? If you want to run merging without known initial "
-               "positions of robots please set `known_init_poses` parameter "
-               "to false. See relavant documentation for details.",
-               robot_name.c_str());
-      continue;
+void MapMerge::robotAnnounced(const std_msgs::String::ConstPtr& msg)
+{
+  std::string robot_name = ros::names::resolve(msg->data, false);
+  std::lock_guard<std::mutex> lock(discovery_mutex_);
+  if (robots_.count(robot_name)) {
+    // we already know this robot
+    return;
+  }
+  if (std::find(robot_names_.begin(), robot_names_.end(), robot_name) ==
+      robot_names_.end()) {
+    robot_names_.push_back(robot_name);
+  }
+  addRobot(robot_name);
+}
+
+bool MapMerge::addRobot(const std::string& robot_name)
+{
+  geometry_msgs::Transform init_pose;
+  // default msg constructor does no properly initialize quaternion
+  init_pose.rotation.w = 1;  // create identity quaternion
+
+  if (have_initial_poses_ && !getInitPose(robot_name, init_pose)) {
+    ROS_WARN("Couldn't get initial position for robot [%s]\n"
+             "did you defined parameters map_merge/init_pose_[xyz]? in robot "
+             "namespace? If you want to run merging without known initial "
+             "positions of robots please set `known_init_poses` parameter "
+             "to false. See relavant documentation for details.",
+             robot_name.c_str());
+    return false;
+  }
+
+  ROS_INFO("adding robot [%s] to system", robot_name.c_str());
+  {
+    std::lock_guard<boost::shared_mutex> lock(subscriptions_mutex_);
+    subscriptions_.emplace_front();
+    ++subscriptions_size_;
+  }
+
+  // robots_ are protected by discovery_mutex_
+  MapSubscription& subscription = subscriptions_.front();
+  robots_.insert({robot_name, &subscription});
+  subscription.initial_pose = init_pose;
+
+  /* subscribe callbacks */
+  std::string map_topic = ros::names::append(robot_name, robot_map_topic_);
+  std::string map_updates_topic =
+      ros::names::append(robot_name, robot_map_updates_topic_);
+  ROS_INFO("Subscribing to MAP topic: %s.", map_topic.c_str());
+  subscription.map_sub = node_.subscribe<nav_msgs::OccupancyGrid>(
+      map_topic, 50,
+      [this, &subscription](const nav_msgs::OccupancyGrid::ConstPtr& msg) {
+        fullMapUpdate(msg, subscription);
+      });
+  ROS_INFO("Subscribing to MAP updates topic: %s.", map_updates_topic.c_str());
+  subscription.map_updates_sub =
+      node_.subscribe<map_msgs::OccupancyGridUpdate>(
+          map_updates_topic, 50,
+          [this, &subscription](
+              const map_msgs::OccupancyGridUpdate::ConstPtr& msg) {
+            partialMapUpdate(msg, subscription);
+          });
+
+  return true;
+}
+
+void MapMerge::restoreSnapshot()
+{
+  std::vector<RobotSnapshot> robots;
+  if (!loadSnapshot(snapshot_file_, robots)) {
+    ROS_WARN("could not load snapshot from %s, starting without it.",
+             snapshot_file_.c_str());
+    return;
+  }
+
+  ROS_INFO("restoring %zu robots from snapshot %s", robots.size(),
+           snapshot_file_.c_str());
+  std::shared_ptr<EstimatedTransforms> estimated(new EstimatedTransforms());
+  {
+    std::lock_guard<std::mutex> lock(discovery_mutex_);
+    for (const auto& robot : robots) {
+      if (!robots_.count(robot.name) && !addRobot(robot.name)) {
+        continue;
+      }
+      MapSubscription& subscription = *robots_[robot.name];
+      {
+        std::lock_guard<std::mutex> s_lock(subscription.mutex);
+        subscription.map.reset(robot.map);
+        ++subscription.version;
+        subscription.map_replaced = true;
+        subscription.changed_region = cv::Rect();
+      }
+      if (robot.has_transform) {
+        estimated->emplace(&subscription, robot.transform);
+      }
     }
+  }
+  if (!have_initial_poses_) {
+    std::atomic_store(&estimated_transforms_,
+                      std::shared_ptr<const EstimatedTransforms>(estimated));
+  }
+  notifyChange();
+}
 
-    ROS_INFO("adding robot [%s] to system", robot_name.c_str());
+void MapMerge::writeSnapshot()
+{
+  std::vector<std::pair<std::string, MapSubscription*>> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(discovery_mutex_);
+    subscriptions.assign(robots_.begin(), robots_.end());
+  }
+  std::shared_ptr<const EstimatedTransforms> estimated =
+      std::atomic_load(&estimated_transforms_);
+
+  std::vector<RobotSnapshot> robots;
+  robots.reserve(subscriptions.size());
+  for (const auto& subscription : subscriptions) {
+    TiledGrid map;
     {
-      std::lock_guard<boost::shared_mutex> lock(subscriptions_mutex_);
-      subscriptions_.emplace_front();
-      ++subscriptions_size_;
+      std::lock_guard<std::mutex> lock(subscription.second->mutex);
+      map = subscription.second->map;
+    }
+    if (map.empty()) {
+      continue;
+    }
+    RobotSnapshot robot;
+    robot.name = subscription.first;
+    robot.map = map.modified() ? map.copy() : map.base();
+    if (!have_initial_poses_ && estimated) {
+      auto it = estimated->find(subscription.second);
+      if (it != estimated->end()) {
+        robot.has_transform = true;
+        robot.transform = it->second;
+      }
     }
+    robots.push_back(std::move(robot));
+  }
 
-    // no locking here. robots_ are used only in this procedure
-    MapSubscription& subscription = subscriptions_.front();
-    robots_.insert({robot_name, &subscription});
-    subscription.initial_pose = init_pose;
-
-    /* subscribe callbacks */
-    map_topic = ros::names::append(robot_name, robot_map_topic_);
-    map_updates_topic =
-        ros::names::append(robot_name, robot_map_updates_topic_);
-    ROS_INFO("Subscribing to MAP topic: %s.", map_topic.c_str());
-    subscription.map_sub = node_.subscribe<nav_msgs::OccupancyGrid>(
-        map_topic, 50,
-        [this, &subscription](const nav_msgs::OccupancyGrid::ConstPtr& msg) {
-          fullMapUpdate(msg, subscription);
-        });
-    ROS_INFO("Subscribing to MAP updates topic: %s.",
-             map_updates_topic.c_str());
-    subscription.map_updates_sub =
-        node_.subscribe<map_msgs::OccupancyGridUpdate>(
-            map_updates_topic, 50,
-            [this, &subscription](
-                const map_msgs::OccupancyGridUpdate::ConstPtr& msg) {
-              partialMapUpdate(msg, subscription);
-            });
+  ROS_DEBUG("writing snapshot of %zu robots", robots.size());
+  if (!saveSnapshot(snapshot_file_, robots)) {
+    ROS_ERROR("could not write snapshot to %s", snapshot_file_.c_str());
   }
 }
 
@@ -147,29 +317,16 @@ void MapMerge::mapMerging()
 {
   ROS_DEBUG("Map merging started.");
 
-  if (have_initial_poses_) {
-    std::vector<nav_msgs::OccupancyGridConstPtr> grids;
-    std::vector<geometry_msgs::Transform> transforms;
-    grids.reserve(subscriptions_size_);
-    {
-      boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
-      for (auto& subscription : subscriptions_) {
-        std::lock_guard<std::mutex> s_lock(subscription.mutex);
-        grids.push_back(subscription.readonly_map);
-        transforms.push_back(subscription.initial_pose);
-      }
-    }
-    // we don't need to lock here, because when have_initial_poses_ is true we
-    // will not run concurrently on the pipeline
-    pipeline_.feed(grids.begin(), grids.end());
-    pipeline_.setTransforms(transforms.begin(), transforms.end());
-  }
-
-  nav_msgs::OccupancyGridPtr merged_map;
+  // merging pipeline is used only by this thread, estimation runs on its own
+  // pipeline and hands over only transforms
+  feedPipeline();
   {
-    std::lock_guard<std::mutex> lock(pipeline_mutex_);
-    merged_map = pipeline_.composeGrids();
+    // let the pipeline reuse the merged map
+    std::lock_guard<std::mutex> lock(merged_map_mutex_);
+    merged_map_.reset();
   }
+  nav_msgs::OccupancyGridPtr merged_map = pipeline_.composeGrids();
+  const std::vector<cv::Rect>& changed_regions = pipeline_.getChangedRegions();
   if (!merged_map) {
     return;
   }
@@ -181,42 +338,235 @@ void MapMerge::mapMerging()
   merged_map->header.frame_id = world_frame_;
 
   ROS_ASSERT(merged_map->info.resolution > 0.f);
-  merged_map_publisher_.publish(merged_map);
+  {
+    std::lock_guard<std::mutex> lock(merged_map_mutex_);
+    merged_map_ = merged_map;
+  }
+  // full map is needed when map geometry changes, otherwise only changed
+  // parts are sent, with full map once per full_map_interval_
+  const nav_msgs::MapMetaData& info = merged_map->info;
+  bool same_geometry =
+      info.width == last_full_map_info_.width &&
+      info.height == last_full_map_info_.height &&
+      info.resolution == last_full_map_info_.resolution &&
+      info.origin.position.x == last_full_map_info_.origin.position.x &&
+      info.origin.position.y == last_full_map_info_.origin.position.y;
+  bool whole_map_changed =
+      changed_regions.size() == 1 &&
+      changed_regions[0].area() == static_cast<int>(info.width * info.height);
+  bool full_map_requested = full_map_requested_.exchange(false);
+  if (!same_geometry || whole_map_changed || full_map_requested ||
+      full_map_interval_.isZero() ||
+      now - last_full_map_time_ >= full_map_interval_) {
+    merged_map_publisher_.publish(merged_map);
+    last_full_map_info_ = info;
+    last_full_map_time_ = now;
+    return;
+  }
+
+  publishMapUpdates(*merged_map, changed_regions);
+}
+
+void MapMerge::mergedMapSubscribed(const ros::SingleSubscriberPublisher& pub)
+{
+  nav_msgs::OccupancyGrid::ConstPtr merged_map;
+  {
+    std::lock_guard<std::mutex> lock(merged_map_mutex_);
+    merged_map = merged_map_;
+  }
+  if (merged_map) {
+    pub.publish(*merged_map);
+  } else {
+    // merging is in progress, the next merge sends the full map
+    full_map_requested_ = true;
+  }
+}
+
+void MapMerge::publishMapUpdates(const nav_msgs::OccupancyGrid& merged_map,
+                                 const std::vector<cv::Rect>& regions)
+{
+  for (const auto& region : regions) {
+    map_msgs::OccupancyGridUpdate update;
+    update.header = merged_map.header;
+    update.x = region.x;
+    update.y = region.y;
+    update.width = static_cast<uint32_t>(region.width);
+    update.height = static_cast<uint32_t>(region.height);
+    update.data.reserve(static_cast<size_t>(region.area()));
+    for (int y = region.y; y < region.y + region.height; ++y) {
+      auto row = merged_map.data.begin() +
+                 static_cast<ptrdiff_t>(size_t(y) * merged_map.info.width +
+                                        size_t(region.x));
+      update.data.insert(update.data.end(), row, row + region.width);
+    }
+    merged_map_updates_publisher_.publish(update);
+  }
 }
 
 void MapMerge::poseEstimation()
 {
   ROS_DEBUG("Grid pose estimation started.");
+  std::vector<MapSubscription*> subscriptions;
+  std::vector<TiledGrid> maps;
+  std::vector<size_t> versions;
+  {
+    boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
+    for (auto& subscription : subscriptions_) {
+      std::lock_guard<std::mutex> s_lock(subscription.mutex);
+      subscriptions.push_back(&subscription);
+      maps.push_back(subscription.map);
+      versions.push_back(subscription.version);
+    }
+  }
+
+  // estimation works on its own grids. grids of unchanged maps are fed again
+  // as the same objects, so the pipeline can reuse their features.
   std::vector<nav_msgs::OccupancyGridConstPtr> grids;
-  grids.reserve(subscriptions_size_);
+  grids.reserve(subscriptions.size());
+  bool changed = subscriptions.size() != estimated_robots_;
+  for (size_t i = 0; i < subscriptions.size(); ++i) {
+    MapSubscription& subscription = *subscriptions[i];
+    if (!subscription.estimation_map ||
+        subscription.estimation_version != versions[i]) {
+      subscription.estimation_map =
+          maps[i].modified() ? maps[i].copy() : maps[i].base();
+      subscription.estimation_version = versions[i];
+      changed = true;
+    }
+    grids.push_back(subscription.estimation_map);
+  }
+  if (estimation_tracking_ && !changed) {
+    // transforms can't change for the same grids
+    return;
+  }
+
+  estimation_pipeline_.feed(grids.begin(), grids.end());
+  estimated_robots_ = subscriptions.size();
+  // once all transforms are known they are only tracked, until grids diverge
+  // or a new robot appears
+  if (estimation_tracking_ && estimation_pipeline_.trackTransforms()) {
+    ROS_DEBUG("transforms tracked");
+  } else {
+    // TODO allow user to change feature type
+    estimation_pipeline_.estimateTransforms(combine_grids::FeatureType::AKAZE,
+                                            confidence_threshold_);
+  }
+
+  // hand over transforms to merging
+  std::vector<geometry_msgs::Transform> transforms =
+      estimation_pipeline_.getTransforms();
+  std::shared_ptr<EstimatedTransforms> estimated(new EstimatedTransforms());
+  for (size_t i = 0; i < subscriptions.size() && i < transforms.size(); ++i) {
+    estimated->emplace(subscriptions[i], transforms[i]);
+  }
+  std::shared_ptr<const EstimatedTransforms> previous = std::atomic_exchange(
+      &estimated_transforms_,
+      std::shared_ptr<const EstimatedTransforms>(estimated));
+  if (!previous || *previous != *estimated) {
+    notifyChange();
+  }
+}
+
+void MapMerge::feedPipeline()
+{
+  std::vector<MapSubscription*> subscriptions;
+  std::vector<TiledGrid> maps;
+  std::vector<geometry_msgs::Transform> transforms;
+  std::vector<bool> replaced;
+  std::vector<cv::Rect> changed_regions;
+  subscriptions.reserve(subscriptions_size_);
+  maps.reserve(subscriptions_size_);
+  std::shared_ptr<const EstimatedTransforms> estimated;
+  if (!have_initial_poses_) {
+    estimated = std::atomic_load(&estimated_transforms_);
+  }
   {
     boost::shared_lock<boost::shared_mutex> lock(subscriptions_mutex_);
     for (auto& subscription : subscriptions_) {
       std::lock_guard<std::mutex> s_lock(subscription.mutex);
-      grids.push_back(subscription.readonly_map);
+      subscriptions.push_back(&subscription);
+      // snapshot shares tiles with the subscription
+      maps.push_back(subscription.map);
+      if (have_initial_poses_) {
+        transforms.push_back(subscription.initial_pose);
+      } else {
+        // maps not estimated yet have invalid transform and are not merged
+        geometry_msgs::Transform transform;
+        if (estimated) {
+          auto it = estimated->find(&subscription);
+          if (it != estimated->end()) {
+            transform = it->second;
+          }
+        }
+        transforms.push_back(transform);
+      }
+      replaced.push_back(subscription.map_replaced);
+      changed_regions.push_back(subscription.changed_region);
+      subscription.map_replaced = false;
+      subscription.changed_region = cv::Rect();
+    }
+  }
+
+  // bring contiguous grids up-to-date, copy only changed parts if possible
+  std::vector<nav_msgs::OccupancyGridConstPtr> grids;
+  grids.reserve(subscriptions.size());
+  for (size_t i = 0; i < subscriptions.size(); ++i) {
+    MapSubscription& subscription = *subscriptions[i];
+    const TiledGrid& map = maps[i];
+    if (replaced[i]) {
+      if (map.modified()) {
+        subscription.fed_writable_map = map.copy();
+        subscription.fed_map = subscription.fed_writable_map;
+      } else {
+        // full map is used as is
+        subscription.fed_writable_map = nullptr;
+        subscription.fed_map = map.base();
+      }
+    } else if (changed_regions[i].area() > 0) {
+      if (subscription.fed_writable_map) {
+        map.copyTo(changed_regions[i], *subscription.fed_writable_map);
+        subscription.fed_writable_map->header.stamp = map.stamp();
+      } else {
+        // first update since full map, fed_map is the full map message
+        subscription.fed_writable_map = map.copy();
+        subscription.fed_map = subscription.fed_writable_map;
+      }
     }
+    grids.push_back(subscription.fed_map);
   }
 
-  std::lock_guard<std::mutex> lock(pipeline_mutex_);
   pipeline_.feed(grids.begin(), grids.end());
-  // TODO allow user to change feature type
-  pipeline_.estimateTransforms(combine_grids::FeatureType::AKAZE,
-                               confidence_threshold_);
+  // let the pipeline process only changed parts of maps
+  for (size_t i = 0; i < grids.size(); ++i) {
+    if (!replaced[i]) {
+      pipeline_.setChangedRegion(i, changed_regions[i]);
+    }
+  }
+  pipeline_.setTransforms(transforms.begin(), transforms.end());
 }
 
 void MapMerge::fullMapUpdate(const nav_msgs::OccupancyGrid::ConstPtr& msg,
                              MapSubscription& subscription)
 {
   ROS_DEBUG("received full map update");
+  if (msg->data.size() < size_t(msg->info.width) * msg->info.height) {
+    ROS_ERROR("received map with only %lu cells for %ux%u grid, skipping.",
+              msg->data.size(), msg->info.width, msg->info.height);
+    return;
+  }
+
   std::lock_guard<std::mutex> lock(subscription.mutex);
-  if (subscription.readonly_map &&
-      subscription.readonly_map->header.stamp > msg->header.stamp) {
+  if (!subscription.map.empty() &&
+      subscription.map.stamp() > msg->header.stamp) {
     // we have been overrunned by faster update. our work was useless.
     return;
   }
 
-  subscription.readonly_map = msg;
-  subscription.writable_map = nullptr;
+  subscription.map.reset(msg);
+  ++subscription.version;
+  subscription.map_replaced = true;
+  subscription.changed_region = cv::Rect();
+  notifyChange();
 }
 
 void MapMerge::partialMapUpdate(
@@ -230,66 +580,66 @@ void MapMerge::partialMapUpdate(
               msg->y);
     return;
   }
-
-  size_t x0 = static_cast<size_t>(msg->x);
-  size_t y0 = static_cast<size_t>(msg->y);
-  size_t xn = msg->width + x0;
-  size_t yn = msg->height + y0;
-
-  nav_msgs::OccupancyGridPtr map;
-  nav_msgs::OccupancyGridConstPtr readonly_map;  // local copy
-  {
-    // load maps
-    std::lock_guard<std::mutex> lock(subscription.mutex);
-    map = subscription.writable_map;
-    readonly_map = subscription.readonly_map;
+  if (msg->data.size() < size_t(msg->width) * msg->height) {
+    ROS_ERROR("received update with only %lu cells for %ux%u region, "
+              "skipping.",
+              msg->data.size(), msg->width, msg->height);
+    return;
   }
 
-  if (!readonly_map) {
+  // only tiles touched by the update are copied, so this is cheap enough to
+  // be done under the lock
+  std::lock_guard<std::mutex> lock(subscription.mutex);
+  if (subscription.map.empty()) {
     ROS_WARN("received partial map update, but don't have any full map to "
              "update. skipping.");
     return;
   }
-
-  // we don't have partial map to take update, we must copy readonly map and
-  // update new writable map
-  if (!map) {
-    map.reset(new nav_msgs::OccupancyGrid(*readonly_map));
+  if (subscription.map.stamp() > msg->header.stamp) {
+    // we have been overrunned by faster update. our work was useless.
+    return;
   }
 
-  size_t grid_xn = map->info.width;
-  size_t grid_yn = map->info.height;
-
-  if (xn > grid_xn || x0 > grid_xn || yn > grid_yn || y0 > grid_yn) {
+  cv::Rect region = subscription.map.update(*msg);
+  if (region.width != static_cast<int>(msg->width) ||
+      region.height != static_cast<int>(msg->height)) {
     ROS_WARN("received update doesn't fully fit into existing map, "
-             "only part will be copied. received: [%lu, %lu], [%lu, %lu] "
-             "map is: [0, %lu], [0, %lu]",
-             x0, xn, y0, yn, grid_xn, grid_yn);
-  }
-
-  // update map with data
-  size_t i = 0;
-  for (size_t y = y0; y < yn && y < grid_yn; ++y) {
-    for (size_t x = x0; x < xn && x < grid_xn; ++x) {
-      size_t idx = y * grid_xn + x;  // index to grid for this specified cell
-      map->data[idx] = msg->data[i];
-      ++i;
-    }
+             "only part will be copied. received: [%d, %u], [%d, %u] "
+             "map is: [0, %u], [0, %u]",
+             msg->x, msg->x + msg->width, msg->y, msg->y + msg->height,
+             subscription.map.base()->info.width,
+             subscription.map.base()->info.height);
   }
-  // update time stamp
-  map->header.stamp = msg->header.stamp;
+  if (region.area() > 0) {
+    ++subscription.version;
+    cv::Rect& changed = subscription.changed_region;
+    changed = changed.area() > 0 ? (changed | region) : region;
+    notifyChange();
+  }
+}
 
+void MapMerge::notifyChange()
+{
   {
-    // store back updated map
-    std::lock_guard<std::mutex> lock(subscription.mutex);
-    if (subscription.readonly_map &&
-        subscription.readonly_map->header.stamp > map->header.stamp) {
-      // we have been overrunned by faster update. our work was useless.
-      return;
-    }
-    subscription.writable_map = map;
-    subscription.readonly_map = map;
+    std::lock_guard<std::mutex> lock(changes_mutex_);
+    ++changes_version_;
   }
+  changes_condition_.notify_one();
+}
+
+void MapMerge::waitForChange(size_t& version)
+{
+  std::unique_lock<std::mutex> lock(changes_mutex_);
+  auto changed = [this, &version]() {
+    return changes_version_ != version || !node_.ok();
+  };
+  if (min_merging_rate_ > 0.) {
+    changes_condition_.wait_for(
+        lock, std::chrono::duration<double>(1. / min_merging_rate_), changed);
+  } else {
+    changes_condition_.wait(lock, changed);
+  }
+  version = changes_version_;
 }
 
 std::string MapMerge::robotNameFromTopic(const std::string& topic)
@@ -350,8 +700,16 @@ bool MapMerge::getInitPose(const std::string& name,
  */
 void MapMerge::executemapMerging()
 {
+  // maps are merged only when they change, at most at merging_rate_
   ros::Rate r(merging_rate_);
+  size_t version = 0;
   while (node_.ok()) {
+    waitForChange(version);
+    if (!node_.ok()) {
+      break;
+    }
+    // rate is measured from the last merge, not from the last wait
+    r.reset();
     mapMerging();
     r.sleep();
   }
@@ -378,6 +736,22 @@ void MapMerge::executeposeEstimation()
   }
 }
 
+void MapMerge::executesnapshotWriting()
+{
+  if (snapshot_file_.empty() || snapshot_interval_ <= 0.)
+    return;
+
+  // wait is interrupted on shutdown, the final snapshot is written by spin()
+  auto interval = std::chrono::duration<double>(snapshot_interval_);
+  std::unique_lock<std::mutex> lock(snapshot_mutex_);
+  while (!snapshot_condition_.wait_for(lock, interval,
+                                       [this]() { return !node_.ok(); })) {
+    lock.unlock();
+    writeSnapshot();
+    lock.lock();
+  }
+}
+
 /*
  * spin()
  */
@@ -387,10 +761,26 @@ void MapMerge::spin()
   std::thread merging_thr([this]() { executemapMerging(); });
   std::thread subscribing_thr([this]() { executetopicSubscribing(); });
   std::thread estimation_thr([this]() { executeposeEstimation(); });
+  std::thread snapshot_thr([this]() { executesnapshotWriting(); });
   ros::spin();
+  // wake up merging waiting for changes. the lock makes sure merging either
+  // sees the shutdown or already waits for notification.
+  {
+    std::lock_guard<std::mutex> lock(changes_mutex_);
+  }
+  changes_condition_.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  }
+  snapshot_condition_.notify_all();
   estimation_thr.join();
   merging_thr.join();
   subscribing_thr.join();
+  snapshot_thr.join();
+  // last state of robots is kept over restart
+  if (!snapshot_file_.empty()) {
+    writeSnapshot();
+  }
 }
 
 }  // namespace map_merge
@@ -0,0 +1,287 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <map_merge/snapshot.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <ros/serialization.h>
+
+namespace map_merge
+{
+namespace
+{
+// identifies snapshot files, followed by format version
+const char magic[4] = {'M', 'M', 'S', 'N'};
+const uint32_t format_version = 1;
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// bytes left in the file. lengths read from a corrupt file are checked
+// against it before anything is allocated.
+uint64_t remaining(std::istream& in)
+{
+  std::streampos pos = in.tellg();
+  if (pos < 0) {
+    return 0;
+  }
+  in.seekg(0, std::ios::end);
+  std::streampos end = in.tellg();
+  in.seekg(pos);
+  return end > pos ? uint64_t(end - pos) : 0;
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value)
+{
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// writes ROS message prefixed by its length
+template <typename M>
+void writeMessage(std::ostream& out, const M& msg)
+{
+  uint32_t length = ros::serialization::serializationLength(msg);
+  std::vector<uint8_t> buffer(length);
+  ros::serialization::OStream stream(buffer.data(), length);
+  ros::serialization::serialize(stream, msg);
+  writeValue(out, length);
+  out.write(reinterpret_cast<const char*>(buffer.data()), length);
+}
+
+template <typename M>
+bool readMessage(std::istream& in, M& msg)
+{
+  uint32_t length;
+  if (!readValue(in, length) || length > remaining(in)) {
+    return false;
+  }
+  std::vector<uint8_t> buffer(length);
+  if (!in.read(reinterpret_cast<char*>(buffer.data()), length)) {
+    return false;
+  }
+  try {
+    ros::serialization::IStream stream(buffer.data(), length);
+    ros::serialization::deserialize(stream, msg);
+  } catch (const ros::serialization::StreamOverrunException&) {
+    return false;
+  }
+  return true;
+}
+
+// occupancy data are mostly long runs of unknown or free cells. exactly size
+// cells are written, missing data are written as unknown.
+void writeRuns(std::ostream& out, const std::vector<int8_t>& data,
+               size_t size)
+{
+  auto cell = [&data](size_t i) -> int8_t {
+    return i < data.size() ? data[i] : -1;
+  };
+  std::vector<std::pair<uint32_t, int8_t>> runs;
+  for (size_t i = 0; i < size;) {
+    size_t j = i + 1;
+    while (j < size && cell(j) == cell(i) && j - i < UINT32_MAX) {
+      ++j;
+    }
+    runs.emplace_back(static_cast<uint32_t>(j - i), cell(i));
+    i = j;
+  }
+  writeValue(out, static_cast<uint32_t>(runs.size()));
+  for (const auto& run : runs) {
+    writeValue(out, run.first);
+    writeValue(out, run.second);
+  }
+}
+
+bool readRuns(std::istream& in, size_t size, std::vector<int8_t>& data)
+{
+  const uint64_t run_size = sizeof(uint32_t) + sizeof(int8_t);
+  uint32_t count;
+  if (!readValue(in, count) || count > remaining(in) / run_size) {
+    return false;
+  }
+  // runs must describe exactly size cells before the data are allocated
+  std::vector<std::pair<uint32_t, int8_t>> runs(count);
+  uint64_t total = 0;
+  for (auto& run : runs) {
+    if (!readValue(in, run.first) || !readValue(in, run.second)) {
+      return false;
+    }
+    total += run.first;
+  }
+  if (total != size) {
+    return false;
+  }
+  data.clear();
+  data.reserve(size);
+  for (const auto& run : runs) {
+    data.insert(data.end(), run.first, run.second);
+  }
+  return true;
+}
+
+bool readRobot(std::istream& in, RobotSnapshot& robot)
+{
+  uint32_t name_length;
+  if (!readValue(in, name_length) || name_length > remaining(in)) {
+    return false;
+  }
+  robot.name.resize(name_length);
+  if (!in.read(&robot.name[0], name_length)) {
+    return false;
+  }
+  uint8_t has_transform;
+  nav_msgs::OccupancyGrid::Ptr map(new nav_msgs::OccupancyGrid());
+  if (!readValue(in, has_transform) || !readMessage(in, robot.transform) ||
+      !readMessage(in, map->header) || !readMessage(in, map->info) ||
+      !readRuns(in, size_t(map->info.width) * map->info.height, map->data)) {
+    return false;
+  }
+  robot.has_transform = has_transform != 0;
+  robot.map = map;
+  return true;
+}
+
+}  // namespace
+
+bool saveSnapshot(const std::string& path,
+                  const std::vector<RobotSnapshot>& robots)
+{
+  // write to temporary file first, so the previous snapshot is kept intact
+  // until the new one is complete
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    out.write(magic, sizeof(magic));
+    writeValue(out, format_version);
+    uint32_t count = 0;
+    for (const auto& robot : robots) {
+      count += robot.map ? 1 : 0;
+    }
+    writeValue(out, count);
+    for (const auto& robot : robots) {
+      if (!robot.map) {
+        continue;
+      }
+      writeValue(out, static_cast<uint32_t>(robot.name.size()));
+      out.write(robot.name.data(),
+                static_cast<std::streamsize>(robot.name.size()));
+      writeValue(out, static_cast<uint8_t>(robot.has_transform));
+      writeMessage(out, robot.transform);
+      writeMessage(out, robot.map->header);
+      writeMessage(out, robot.map->info);
+      writeRuns(out, robot.map->data,
+                size_t(robot.map->info.width) * robot.map->info.height);
+    }
+    out.close();
+    if (!out) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+
+  // data must be on disk before the rename, otherwise a power loss may leave
+  // an empty snapshot in place of the previous one
+  int fd = ::open(tmp_path.c_str(), O_RDONLY);
+  if (fd < 0 || ::fsync(fd) != 0) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  ::close(fd);
+
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool loadSnapshot(const std::string& path, std::vector<RobotSnapshot>& robots)
+{
+  robots.clear();
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  char file_magic[sizeof(magic)];
+  uint32_t version;
+  uint32_t count;
+  if (!in.read(file_magic, sizeof(file_magic)) ||
+      std::memcmp(file_magic, magic, sizeof(magic)) != 0 ||
+      !readValue(in, version) || version != format_version ||
+      !readValue(in, count)) {
+    return false;
+  }
+
+  std::vector<RobotSnapshot> result;
+  try {
+    for (uint32_t i = 0; i < count; ++i) {
+      RobotSnapshot robot;
+      if (!readRobot(in, robot)) {
+        return false;
+      }
+      result.push_back(std::move(robot));
+    }
+  } catch (const std::bad_alloc&) {
+    // lengths are checked against the file size, but a corrupt map size can
+    // still be too large
+    return false;
+  } catch (const std::length_error&) {
+    return false;
+  }
+  robots = std::move(result);
+  return true;
+}
+
+}  // namespace map_merge
@@ -0,0 +1,179 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <map_merge/tiled_grid.h>
+
+#include <algorithm>
+
+#include <ros/assert.h>
+
+namespace map_merge
+{
+constexpr int TiledGrid::tile_size;
+
+void TiledGrid::reset(const nav_msgs::OccupancyGrid::ConstPtr& map)
+{
+  base_ = map;
+  stamp_ = map->header.stamp;
+  width_ = static_cast<int>(map->info.width);
+  height_ = static_cast<int>(map->info.height);
+  tiles_x_ = static_cast<size_t>((width_ + tile_size - 1) / tile_size);
+  tiles_y_ = static_cast<size_t>((height_ + tile_size - 1) / tile_size);
+  // never share tiles with copies made before reset
+  tiles_.clear();
+  tiles_.resize(tiles_x_ * tiles_y_);
+  modified_ = false;
+}
+
+cv::Rect TiledGrid::tileRect(size_t tile_x, size_t tile_y) const
+{
+  int x = static_cast<int>(tile_x) * tile_size;
+  int y = static_cast<int>(tile_y) * tile_size;
+  return cv::Rect(x, y, std::min(tile_size, width_ - x),
+                  std::min(tile_size, height_ - y));
+}
+
+TiledGrid::Tile& TiledGrid::writableTile(size_t tile_x, size_t tile_y)
+{
+  std::shared_ptr<Tile>& tile = tiles_[tile_y * tiles_x_ + tile_x];
+  if (!tile) {
+    // first write to this tile, copy it from the full map
+    cv::Rect rect = tileRect(tile_x, tile_y);
+    tile = std::make_shared<Tile>(static_cast<size_t>(rect.area()));
+    for (int y = 0; y < rect.height; ++y) {
+      std::copy_n(base_->data.begin() + (rect.y + y) * width_ + rect.x,
+                  rect.width, tile->begin() + y * rect.width);
+    }
+  } else if (tile.use_count() > 1) {
+    // copies can only release tiles concurrently, unshared tile can't become
+    // shared during write
+    tile = std::make_shared<Tile>(*tile);
+  }
+  return *tile;
+}
+
+cv::Rect TiledGrid::update(const map_msgs::OccupancyGridUpdate& update)
+{
+  if (empty()) {
+    return cv::Rect();
+  }
+
+  cv::Rect update_rect(update.x, update.y, static_cast<int>(update.width),
+                       static_cast<int>(update.height));
+  cv::Rect region = update_rect & cv::Rect(0, 0, width_, height_);
+  if (region.area() <= 0) {
+    return cv::Rect();
+  }
+
+  size_t tx0 = static_cast<size_t>(region.x / tile_size);
+  size_t ty0 = static_cast<size_t>(region.y / tile_size);
+  size_t txn = static_cast<size_t>((region.br().x - 1) / tile_size) + 1;
+  size_t tyn = static_cast<size_t>((region.br().y - 1) / tile_size) + 1;
+  for (size_t ty = ty0; ty < tyn; ++ty) {
+    for (size_t tx = tx0; tx < txn; ++tx) {
+      cv::Rect rect = tileRect(tx, ty);
+      cv::Rect part = rect & region;
+      Tile& tile = writableTile(tx, ty);
+      for (int y = part.y; y < part.br().y; ++y) {
+        auto src = update.data.begin() +
+                   (y - update_rect.y) * update_rect.width +
+                   (part.x - update_rect.x);
+        auto dst = tile.begin() + (y - rect.y) * rect.width + (part.x - rect.x);
+        std::copy_n(src, part.width, dst);
+      }
+    }
+  }
+  stamp_ = update.header.stamp;
+  modified_ = true;
+
+  return region;
+}
+
+void TiledGrid::copyTo(const cv::Rect& region,
+                       nav_msgs::OccupancyGrid& grid) const
+{
+  ROS_ASSERT(static_cast<int>(grid.info.width) == width_ &&
+             static_cast<int>(grid.info.height) == height_);
+  cv::Rect clipped = region & cv::Rect(0, 0, width_, height_);
+  if (clipped.area() <= 0) {
+    return;
+  }
+
+  size_t tx0 = static_cast<size_t>(clipped.x / tile_size);
+  size_t ty0 = static_cast<size_t>(clipped.y / tile_size);
+  size_t txn = static_cast<size_t>((clipped.br().x - 1) / tile_size) + 1;
+  size_t tyn = static_cast<size_t>((clipped.br().y - 1) / tile_size) + 1;
+  for (size_t ty = ty0; ty < tyn; ++ty) {
+    for (size_t tx = tx0; tx < txn; ++tx) {
+      cv::Rect rect = tileRect(tx, ty);
+      cv::Rect part = rect & clipped;
+      const std::shared_ptr<Tile>& tile = tiles_[ty * tiles_x_ + tx];
+      for (int y = part.y; y < part.br().y; ++y) {
+        auto dst = grid.data.begin() + y * width_ + part.x;
+        if (tile) {
+          std::copy_n(tile->begin() + (y - rect.y) * rect.width +
+                          (part.x - rect.x),
+                      part.width, dst);
+        } else {
+          std::copy_n(base_->data.begin() + y * width_ + part.x, part.width,
+                      dst);
+        }
+      }
+    }
+  }
+}
+
+nav_msgs::OccupancyGrid::Ptr TiledGrid::copy() const
+{
+  if (empty()) {
+    return nullptr;
+  }
+
+  nav_msgs::OccupancyGrid::Ptr grid(new nav_msgs::OccupancyGrid());
+  grid->header = base_->header;
+  grid->header.stamp = stamp_;
+  grid->info = base_->info;
+  if (!modified_) {
+    grid->data = base_->data;
+    return grid;
+  }
+  grid->data.resize(base_->data.size());
+  copyTo(cv::Rect(0, 0, width_, height_), *grid);
+
+  return grid;
+}
+
+}  // namespace map_merge
@@ -0,0 +1,289 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <benchmark/benchmark.h>
+#include <array>
+#include <ros/console.h>
+#include <opencv2/core/utility.hpp>
+#include "testing_helpers.h"
+
+#include <combine_grids/merging_pipeline.h>
+#include <map_merge/tiled_grid.h>
+
+/* Benchmarks of the merging pipeline. Real maps are loaded from the working
+ * directory (the same maps as used by test_merging_pipeline), benchmarks
+ * needing them are skipped if maps are not available. Use
+ * --benchmark_format=json or --benchmark_out=<file> for machine-readable
+ * results. */
+
+const std::array<const char*, 2> hector_maps = {
+    "map00.pgm",
+    "map05.pgm",
+};
+
+static std::vector<nav_msgs::OccupancyGridConstPtr> loadHectorMaps()
+{
+  try {
+    return loadMaps(hector_maps.begin(), hector_maps.end());
+  } catch (const std::runtime_error&) {
+    return {};
+  }
+}
+
+// synthetic map of rooms of size room separated by walls with doors, a part
+// of the map is left unknown
+static nav_msgs::OccupancyGridPtr syntheticMap(unsigned int size,
+                                               unsigned int room)
+{
+  nav_msgs::OccupancyGridPtr grid(new nav_msgs::OccupancyGrid());
+  grid->info.width = size;
+  grid->info.height = size;
+  grid->info.resolution = resolution;
+  grid->data.assign(size_t(size) * size, 0);
+  auto door = [room](unsigned int i) {
+    return i % room >= room / 3 && i % room < room / 2;
+  };
+  for (unsigned int y = 0; y < size; ++y) {
+    for (unsigned int x = 0; x < size; ++x) {
+      bool wall = (x % room == 0 && !door(y)) || (y % room == 0 && !door(x));
+      if (wall) {
+        grid->data[size_t(y) * size + x] = 100;
+      } else if (x + y > 3 * size / 2) {
+        grid->data[size_t(y) * size + x] = -1;
+      }
+    }
+  }
+  return grid;
+}
+
+// transforms placing maps next to each other with a small overlap
+static std::vector<geometry_msgs::Transform>
+gridTransforms(size_t count, unsigned int size, double angle)
+{
+  std::vector<geometry_msgs::Transform> transforms(count);
+  transforms[0].rotation.w = 1.0;
+  for (size_t i = 1; i < count; ++i) {
+    // rotate around z axis
+    transforms[i].rotation.w = std::cos(angle / 2.);
+    transforms[i].rotation.z = std::sin(angle / 2.);
+    transforms[i].translation.x = -(0.9 * size) * double(i % 4);
+    transforms[i].translation.y = -(0.9 * size) * double(i / 4);
+  }
+  return transforms;
+}
+
+static std::vector<nav_msgs::OccupancyGridConstPtr>
+syntheticMaps(size_t count, unsigned int size)
+{
+  std::vector<nav_msgs::OccupancyGridConstPtr> maps;
+  for (size_t i = 0; i < count; ++i) {
+    maps.push_back(syntheticMap(size, 50));
+  }
+  return maps;
+}
+
+static void BM_Feed(benchmark::State& state)
+{
+  auto maps = syntheticMaps(size_t(state.range(0)),
+                            static_cast<unsigned int>(state.range(1)));
+  combine_grids::MergingPipeline merger;
+  for (auto _ : state) {
+    merger.feed(maps.begin(), maps.end());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_Feed)->ArgNames({"robots", "size"})->Args({2, 1024})->Args(
+    {32, 1024});
+
+static void BM_EstimateTransforms(benchmark::State& state)
+{
+  auto maps = loadHectorMaps();
+  if (maps.empty()) {
+    state.SkipWithError("test maps not available");
+    return;
+  }
+  auto feature_type = static_cast<combine_grids::FeatureType>(state.range(0));
+  for (auto _ : state) {
+    // new pipeline does not reuse features from previous iterations
+    combine_grids::MergingPipeline merger;
+    merger.setPyramidLevels(static_cast<int>(state.range(1)));
+    merger.feed(maps.begin(), maps.end());
+    try {
+      benchmark::DoNotOptimize(merger.estimateTransforms(feature_type));
+    } catch (const cv::Exception& e) {
+      // SURF is not available in all OpenCV builds
+      state.SkipWithError(e.what());
+      return;
+    }
+  }
+}
+BENCHMARK(BM_EstimateTransforms)
+    ->ArgNames({"features", "pyramid"})
+    ->Args({int(combine_grids::FeatureType::AKAZE), 0})
+    ->Args({int(combine_grids::FeatureType::ORB), 0})
+    ->Args({int(combine_grids::FeatureType::SURF), 0})
+    ->Args({int(combine_grids::FeatureType::AKAZE), 2})
+    ->Unit(benchmark::kMillisecond);
+
+// re-estimation of unchanged grids, features and matches are reused
+static void BM_EstimateTransformsCached(benchmark::State& state)
+{
+  auto maps = loadHectorMaps();
+  if (maps.empty()) {
+    state.SkipWithError("test maps not available");
+    return;
+  }
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  for (auto _ : state) {
+    merger.feed(maps.begin(), maps.end());
+    benchmark::DoNotOptimize(merger.estimateTransforms());
+  }
+}
+BENCHMARK(BM_EstimateTransformsCached)->Unit(benchmark::kMillisecond);
+
+static void BM_TrackTransforms(benchmark::State& state)
+{
+  auto maps = loadHectorMaps();
+  if (maps.empty()) {
+    state.SkipWithError("test maps not available");
+    return;
+  }
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  for (auto _ : state) {
+    merger.feed(maps.begin(), maps.end());
+    benchmark::DoNotOptimize(merger.trackTransforms());
+  }
+}
+BENCHMARK(BM_TrackTransforms)->Unit(benchmark::kMillisecond);
+
+// composing all grids from scratch
+static void BM_ComposeGrids(benchmark::State& state)
+{
+  size_t robots = size_t(state.range(0));
+  unsigned int size = static_cast<unsigned int>(state.range(1));
+  auto maps = syntheticMaps(robots, size);
+  auto transforms = gridTransforms(robots, size, state.range(2) * 1e-2);
+  for (auto _ : state) {
+    state.PauseTiming();
+    combine_grids::MergingPipeline merger;
+    merger.feed(maps.begin(), maps.end());
+    merger.setTransforms(transforms.begin(), transforms.end());
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(merger.composeGrids());
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(robots) *
+                          size * size);
+}
+BENCHMARK(BM_ComposeGrids)
+    ->ArgNames({"robots", "size", "angle"})
+    ->Args({2, 1024, 0})
+    ->Args({2, 1024, 30})
+    ->Args({8, 1024, 0})
+    ->Args({8, 1024, 30})
+    ->Args({32, 1024, 30})
+    ->Args({8, 4096, 30})
+    ->Unit(benchmark::kMillisecond);
+
+// composing after a small part of one grid changed
+static void BM_ComposeGridsChanged(benchmark::State& state)
+{
+  size_t robots = size_t(state.range(0));
+  unsigned int size = static_cast<unsigned int>(state.range(1));
+  auto maps = syntheticMaps(robots, size);
+  auto transforms = gridTransforms(robots, size, 0.3);
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  merger.composeGrids();
+  for (auto _ : state) {
+    merger.feed(maps.begin(), maps.end());
+    merger.setChangedRegion(0, cv::Rect(100, 100, 64, 64));
+    merger.setTransforms(transforms.begin(), transforms.end());
+    benchmark::DoNotOptimize(merger.composeGrids());
+  }
+}
+BENCHMARK(BM_ComposeGridsChanged)
+    ->ArgNames({"robots", "size"})
+    ->Args({8, 1024})
+    ->Args({32, 1024})
+    ->Unit(benchmark::kMicrosecond);
+
+// applying partial map updates to a grid shared with a snapshot, as done for
+// each map update received by the node
+static void BM_TiledGridUpdate(benchmark::State& state)
+{
+  std::mt19937 rng(42);
+  unsigned int size = static_cast<unsigned int>(state.range(0));
+  unsigned int update_size = static_cast<unsigned int>(state.range(1));
+  map_merge::TiledGrid grid;
+  grid.reset(syntheticMap(size, 50));
+  map_msgs::OccupancyGridUpdate update;
+  update.width = update_size;
+  update.height = update_size;
+  update.data.assign(size_t(update_size) * update_size, 100);
+  std::uniform_int_distribution<int> position(0, int(size - update_size));
+  for (auto _ : state) {
+    // snapshot taken for merging forces copy of updated tiles
+    map_merge::TiledGrid snapshot = grid;
+    update.x = position(rng);
+    update.y = position(rng);
+    benchmark::DoNotOptimize(grid.update(update));
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * update_size *
+                          update_size);
+}
+BENCHMARK(BM_TiledGridUpdate)
+    ->ArgNames({"size", "update"})
+    ->Args({4096, 16})
+    ->Args({4096, 256});
+
+int main(int argc, char** argv)
+{
+  ros::Time::init();
+  // keep the pipeline quiet, debug output would dominate timings
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME,
+                                     ros::console::levels::Warn)) {
+    ros::console::notifyLoggerLevelsChanged();
+  }
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
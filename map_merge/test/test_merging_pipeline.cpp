@@ -34,6 +34,8 @@
  *
  *********************************************************************/
 
+#include <algorithm>
+
 #include <combine_grids/grid_warper.h>
 #include <gtest/gtest.h>
 #include <ros/console.h>
@@ -107,6 +109,77 @@ TEST(MergingPipeline, canStich2Grids)
   }
 }
 
+TEST(MergingPipeline, estimationOpenCL)
+{
+  // falls back to CPU on machines without OpenCL
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.setUseOpenCL(true);
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  auto merged_grid = merger.composeGrids();
+
+  EXPECT_VALID_GRID(merged_grid);
+  EXPECT_NEAR(2091, merged_grid->info.width, 30);
+  EXPECT_NEAR(2091, merged_grid->info.height, 30);
+}
+
+TEST(MergingPipeline, estimationReusesFeatures)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  auto transforms = merger.getTransforms();
+  ASSERT_EQ(merger.features_.size(), 2);
+  auto descriptors = merger.features_[1].features.descriptors.u;
+
+  // unchanged grids are not processed again
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  EXPECT_EQ(merger.features_[1].features.descriptors.u, descriptors);
+  EXPECT_EQ(merger.getTransforms(), transforms);
+
+  // cached results are not tied to order of grids
+  std::reverse(maps.begin(), maps.end());
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  EXPECT_EQ(merger.features_[0].features.descriptors.u, descriptors);
+  auto merged_grid = merger.composeGrids();
+  EXPECT_VALID_GRID(merged_grid);
+  EXPECT_NEAR(2091, merged_grid->info.width, 30);
+  EXPECT_NEAR(2091, merged_grid->info.height, 30);
+
+  // grid changed in place is processed again
+  merger.feed(maps.begin(), maps.end());
+  merger.setChangedRegion(0, cv::Rect(0, 0, 10, 10));
+  merger.estimateTransforms();
+  EXPECT_NE(merger.features_[0].features.descriptors.u, descriptors);
+}
+
+TEST(MergingPipeline, estimationConfirmedPairs)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.setMatchingPolicy(combine_grids::MatchingPolicy::CONFIRMED_PAIRS);
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  ASSERT_EQ(merger.confirmed_.rows, 2);
+  EXPECT_TRUE(merger.confirmed_(0, 1));
+
+  // all grids changed, only confirmed pairs are matched again
+  for (auto& map : maps) {
+    map.reset(new nav_msgs::OccupancyGrid(*map));
+  }
+  merger.feed(maps.begin(), maps.end());
+  merger.estimateTransforms();
+  auto merged_grid = merger.composeGrids();
+
+  EXPECT_VALID_GRID(merged_grid);
+  EXPECT_NEAR(2091, merged_grid->info.width, 30);
+  EXPECT_NEAR(2091, merged_grid->info.height, 30);
+}
+
 TEST(MergingPipeline, canStichGridsGmapping)
 {
   auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
@@ -166,6 +239,75 @@ TEST(MergingPipeline, estimationAccuracy)
   EXPECT_NEAR(ty - roi.tl().y, t.getOrigin().y(), 2);
 }
 
+TEST(MergingPipeline, estimationAccuracyPyramid)
+{
+  // same as estimationAccuracy, but estimated on downsampled grids
+  double angle = 0.523599 /* 30 deg in rads*/;
+  double tx = 0;
+  double ty = 0;
+  cv::Matx23d transform{std::cos(angle), -std::sin(angle), tx,
+                        std::sin(angle), std::cos(angle),  ty};
+
+  auto map = loadMap(hector_maps[1]);
+  combine_grids::MergingPipeline merger;
+  merger.setPyramidLevels(2);
+  merger.feed(&map, &map + 1);
+
+  // warp the map with Affine Transform
+  combine_grids::internal::GridWarper warper;
+  cv::Mat warped;
+  auto roi = warper.warp(merger.images_[0], cv::Mat(transform), warped);
+
+  // add warped map
+  // this relies on internal implementation of merging pipeline
+  merger.grids_.emplace_back();
+  merger.images_.push_back(warped);
+
+  merger.estimateTransforms();
+  auto merged_grid = merger.composeGrids();
+
+  EXPECT_VALID_GRID(merged_grid);
+  // transforms
+  auto transforms = merger.getTransforms();
+  EXPECT_EQ(transforms.size(), 2);
+  EXPECT_TRUE(isIdentity(transforms[0]));
+  tf2::Transform t;
+  tf2::fromMsg(transforms[1], t);
+
+  // rotation is estimated only on downsampled grids
+  EXPECT_NEAR(angle, t.getRotation().getAngle(), 2e-2);
+  EXPECT_NEAR(tx - roi.tl().x, t.getOrigin().x(), 2);
+  EXPECT_NEAR(ty - roi.tl().y, t.getOrigin().y(), 2);
+}
+
+TEST(MergingPipeline, estimationTracking)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.end());
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  // nothing to track yet
+  EXPECT_FALSE(merger.trackTransforms());
+  merger.estimateTransforms();
+  auto transforms = merger.getTransforms();
+  ASSERT_EQ(transforms.size(), 2);
+
+  // tracked transforms stay close to estimated ones
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_TRUE(merger.trackTransforms());
+  auto tracked = merger.getTransforms();
+  ASSERT_EQ(tracked.size(), 2);
+  EXPECT_TRUE(isIdentity(tracked[0]));
+  EXPECT_NEAR(tracked[1].translation.x, transforms[1].translation.x, 2);
+  EXPECT_NEAR(tracked[1].translation.y, transforms[1].translation.y, 2);
+  EXPECT_EQ(tracked[1].rotation, transforms[1].rotation);
+
+  // new grid must be estimated
+  maps.push_back(maps[0]);
+  merger.feed(maps.begin(), maps.end());
+  EXPECT_FALSE(merger.trackTransforms());
+  EXPECT_EQ(merger.getTransforms(), tracked);
+}
+
 TEST(MergingPipeline, transformsRoundTrip)
 {
   auto map = loadMap(hector_maps[0]);
@@ -309,6 +451,206 @@ TEST(MergingPipeline, knownInitPositions)
   }
 }
 
+TEST(MergingPipeline, incrementalCompositing)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  std::vector<geometry_msgs::Transform> transforms{randomTransform(),
+                                                   randomTransform()};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  merger.composeGrids();
+
+  // change part of the first map
+  nav_msgs::OccupancyGridPtr changed_map(
+      new nav_msgs::OccupancyGrid(*maps[0]));
+  cv::Rect region(300, 200, 70, 40);
+  for (int y = region.y; y < region.y + region.height; ++y) {
+    for (int x = region.x; x < region.x + region.width; ++x) {
+      changed_map->data[size_t(y) * changed_map->info.width + size_t(x)] =
+          100;
+    }
+  }
+  maps[0] = changed_map;
+  merger.feed(maps.begin(), maps.end());
+  merger.setChangedRegion(0, region);
+  merger.setTransforms(transforms.begin(), transforms.end());
+  auto merged_grid = merger.composeGrids();
+
+  // compare with grid merged from scratch
+  combine_grids::MergingPipeline full_merger;
+  full_merger.feed(maps.begin(), maps.end());
+  full_merger.setTransforms(transforms.begin(), transforms.end());
+  auto full_grid = full_merger.composeGrids();
+
+  EXPECT_VALID_GRID(merged_grid);
+  // don't use EXPECT_EQ, since it prints too much info
+  EXPECT_TRUE(*merged_grid == *full_grid);
+}
+
+TEST(MergingPipeline, unchangedPartsNotComposed)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  // place the second map next to the first one, so they don't overlap
+  std::vector<geometry_msgs::Transform> transforms(2);
+  transforms[0].rotation.w = 1.0;
+  transforms[1].rotation.w = 1.0;
+  transforms[1].translation.x = -(maps[0]->info.width + 10.0);
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  merger.composeGrids();
+
+  // mark cached composed grid, so we can see which parts are composed again.
+  // this relies on internal implementation of merging pipeline
+  ASSERT_EQ(merger.warped_.size(), 2);
+  merger.merged_.setTo(cv::Scalar::all(7));
+
+  // replace only the first map
+  maps[0].reset(new nav_msgs::OccupancyGrid(*maps[0]));
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  auto merged_grid = merger.composeGrids();
+
+  EXPECT_VALID_GRID(merged_grid);
+  // the first map is composed again, the rest of the grid is untouched
+  cv::Rect first_roi = merger.warped_[0].roi - merger.merged_roi_.tl();
+  EXPECT_EQ(cv::countNonZero(cv::Mat(merger.merged_, first_roi) == 7), 0);
+  EXPECT_GT(cv::countNonZero(merger.merged_ == 7), 0);
+}
+
+TEST(MergingPipeline, maxMergedSize)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  // the second map is placed far away from the first one
+  std::vector<geometry_msgs::Transform> transforms(2);
+  transforms[0].rotation.w = 1.0;
+  transforms[1].rotation.w = 1.0;
+  transforms[1].translation.x = -1e6;
+  combine_grids::MergingPipeline merger;
+  merger.setMaxMergedSize(30000);
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  auto merged_grid = merger.composeGrids();
+
+  // only the reference map fits
+  EXPECT_VALID_GRID(merged_grid);
+  EXPECT_EQ(merged_grid->info.width, maps[0]->info.width);
+  EXPECT_EQ(merged_grid->info.height, maps[0]->info.height);
+  EXPECT_TRUE(merger.warped_[1].transform.empty());
+
+  // both maps fit
+  transforms[1].translation.x = -(maps[0]->info.width + 10.0);
+  merger.setTransforms(transforms.begin(), transforms.end());
+  merged_grid = merger.composeGrids();
+  EXPECT_VALID_GRID(merged_grid);
+  EXPECT_GT(merged_grid->info.width, maps[0]->info.width);
+}
+
+TEST(MergingPipeline, parallelCompositing)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.end());
+  std::vector<geometry_msgs::Transform> transforms{randomTransform(),
+                                                   randomTransform()};
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(transforms.begin(), transforms.end());
+  auto merged_grid = merger.composeGrids();
+
+  // compare with grid merged by a single thread
+  int threads = cv::getNumThreads();
+  cv::setNumThreads(0);
+  combine_grids::MergingPipeline serial_merger;
+  serial_merger.feed(maps.begin(), maps.end());
+  serial_merger.setTransforms(transforms.begin(), transforms.end());
+  auto serial_grid = serial_merger.composeGrids();
+  cv::setNumThreads(threads);
+
+  EXPECT_VALID_GRID(merged_grid);
+  // don't use EXPECT_EQ, since it prints too much info
+  EXPECT_TRUE(*merged_grid == *serial_grid);
+}
+
+TEST(MergingPipeline, changedRegions)
+{
+  auto maps = loadMaps(gmapping_maps.begin(), gmapping_maps.begin() + 1);
+  geometry_msgs::Transform transform;
+  transform.rotation.w = 1.0;
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(&transform, &transform + 1);
+  auto merged_grid = merger.composeGrids();
+  ASSERT_TRUE(merged_grid);
+
+  // the first composed grid is changed as a whole
+  cv::Rect whole(0, 0, int(merged_grid->info.width),
+                 int(merged_grid->info.height));
+  ASSERT_EQ(merger.getChangedRegions().size(), 1u);
+  EXPECT_EQ(merger.getChangedRegions()[0], whole);
+
+  // nothing changes
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(&transform, &transform + 1);
+  merger.composeGrids();
+  EXPECT_TRUE(merger.getChangedRegions().empty());
+
+  nav_msgs::OccupancyGridPtr changed_map(
+      new nav_msgs::OccupancyGrid(*maps[0]));
+  cv::Rect region(300, 200, 70, 40);
+  for (int y = region.y; y < region.y + region.height; ++y) {
+    for (int x = region.x; x < region.x + region.width; ++x) {
+      changed_map->data[size_t(y) * changed_map->info.width + size_t(x)] =
+          100;
+    }
+  }
+  maps[0] = changed_map;
+  merger.feed(maps.begin(), maps.end());
+  merger.setChangedRegion(0, region);
+  merger.setTransforms(&transform, &transform + 1);
+  merged_grid = merger.composeGrids();
+  ASSERT_TRUE(merged_grid);
+
+  // with identity transform composed grid is aligned with the map, changed
+  // cells must be covered by reported regions
+  EXPECT_EQ(merged_grid->info.width, maps[0]->info.width);
+  EXPECT_EQ(merged_grid->info.height, maps[0]->info.height);
+  cv::Rect covered;
+  for (const auto& changed : merger.getChangedRegions()) {
+    EXPECT_EQ(changed & whole, changed);
+    covered = covered.area() > 0 ? (covered | changed) : changed;
+  }
+  EXPECT_EQ(region & covered, region);
+  EXPECT_LT(covered.area(), whole.area());
+}
+
+TEST(MergingPipeline, resultReused)
+{
+  auto maps = loadMaps(hector_maps.begin(), hector_maps.begin() + 1);
+  geometry_msgs::Transform transform;
+  transform.rotation.w = 1.0;
+  combine_grids::MergingPipeline merger;
+  merger.feed(maps.begin(), maps.end());
+  merger.setTransforms(&transform, &transform + 1);
+  auto merged_grid = merger.composeGrids();
+  ASSERT_TRUE(merged_grid);
+  const nav_msgs::OccupancyGrid* released = merged_grid.get();
+  std::vector<int8_t> expected = merged_grid->data;
+
+  // released result is composed again in the same buffer
+  merged_grid.reset();
+  merged_grid = merger.composeGrids();
+  ASSERT_TRUE(merged_grid);
+  EXPECT_EQ(merged_grid.get(), released);
+  EXPECT_EQ(merged_grid->data, expected);
+
+  // result held by the caller is never overwritten
+  auto held_grid = merger.composeGrids();
+  ASSERT_TRUE(held_grid);
+  EXPECT_NE(held_grid.get(), merged_grid.get());
+  EXPECT_EQ(held_grid->data, expected);
+  EXPECT_EQ(held_grid->info.width, maps[0]->info.width);
+}
+
 int main(int argc, char** argv)
 {
   ros::Time::init();
@@ -0,0 +1,179 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+
+#include <gtest/gtest.h>
+#include <map_merge/snapshot.h>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+static nav_msgs::OccupancyGridPtr testGrid(std::mt19937& rng,
+                                           unsigned int width,
+                                           unsigned int height)
+{
+  std::uniform_int_distribution<int> value(-1, 100);
+  nav_msgs::OccupancyGridPtr grid(new nav_msgs::OccupancyGrid());
+  grid->header.frame_id = "map";
+  grid->header.stamp = ros::Time(10, 20);
+  grid->info.width = width;
+  grid->info.height = height;
+  grid->info.resolution = 0.05f;
+  grid->info.origin.position.x = -3.0;
+  grid->info.origin.orientation.w = 1.0;
+  // long runs mixed with random cells, as in real maps
+  grid->data.assign(size_t(width) * height, -1);
+  for (size_t i = 0; i < grid->data.size() / 2; ++i) {
+    grid->data[i] = i % 7 ? 0 : static_cast<int8_t>(value(rng));
+  }
+  return grid;
+}
+
+// tests are run in the build directory
+static std::string snapshotPath()
+{
+  return "test_snapshot.bin";
+}
+
+TEST(Snapshot, roundTrip)
+{
+  std::mt19937 rng(42);
+  std::vector<map_merge::RobotSnapshot> robots(3);
+  robots[0].name = "/robot1";
+  robots[0].map = testGrid(rng, 300, 200);
+  robots[0].has_transform = true;
+  robots[0].transform.translation.x = 12.5;
+  robots[0].transform.rotation.w = 1.0;
+  robots[1].name = "/robot2";
+  robots[1].map = testGrid(rng, 1, 1);
+  // robots without maps are not stored
+  robots[2].name = "/robot3";
+
+  std::string path = snapshotPath();
+  ASSERT_TRUE(map_merge::saveSnapshot(path, robots));
+  std::vector<map_merge::RobotSnapshot> loaded;
+  ASSERT_TRUE(map_merge::loadSnapshot(path, loaded));
+  std::remove(path.c_str());
+
+  ASSERT_EQ(loaded.size(), 2u);
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    EXPECT_EQ(loaded[i].name, robots[i].name);
+    EXPECT_EQ(loaded[i].has_transform, robots[i].has_transform);
+    EXPECT_EQ(loaded[i].transform, robots[i].transform);
+    ASSERT_TRUE(loaded[i].map);
+    // don't use EXPECT_EQ, since it prints too much info
+    EXPECT_TRUE(*loaded[i].map == *robots[i].map);
+  }
+}
+
+TEST(Snapshot, invalidFile)
+{
+  std::mt19937 rng(42);
+  std::vector<map_merge::RobotSnapshot> robots(1);
+  robots[0].name = "/robot1";
+  robots[0].map = testGrid(rng, 100, 100);
+  std::string path = snapshotPath();
+  ASSERT_TRUE(map_merge::saveSnapshot(path, robots));
+
+  // truncated snapshot is rejected as a whole
+  std::ifstream in(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(content.data(), std::streamsize(content.size() / 2));
+  std::vector<map_merge::RobotSnapshot> loaded;
+  EXPECT_FALSE(map_merge::loadSnapshot(path, loaded));
+  EXPECT_TRUE(loaded.empty());
+
+  // so is file of different format
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a snapshot";
+  EXPECT_FALSE(map_merge::loadSnapshot(path, loaded));
+  std::remove(path.c_str());
+
+  EXPECT_FALSE(map_merge::loadSnapshot(path, loaded));
+}
+
+TEST(Snapshot, corruptFile)
+{
+  std::mt19937 rng(42);
+  std::vector<map_merge::RobotSnapshot> robots(1);
+  robots[0].name = "/robot1";
+  robots[0].map = testGrid(rng, 20, 10);
+  std::string path = snapshotPath();
+  ASSERT_TRUE(map_merge::saveSnapshot(path, robots));
+  std::ifstream in(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  in.close();
+
+  // corrupt lengths must not make loading allocate or throw
+  for (size_t i = 0; i < content.size(); ++i) {
+    std::string corrupt = content;
+    corrupt[i] = '\xff';
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(corrupt.data(), std::streamsize(corrupt.size()));
+    std::vector<map_merge::RobotSnapshot> loaded;
+    EXPECT_NO_THROW(map_merge::loadSnapshot(path, loaded));
+  }
+  std::remove(path.c_str());
+}
+
+TEST(Snapshot, trailingData)
+{
+  std::mt19937 rng(42);
+  std::vector<map_merge::RobotSnapshot> robots(1);
+  robots[0].name = "/robot1";
+  nav_msgs::OccupancyGridPtr grid = testGrid(rng, 30, 20);
+  std::vector<int8_t> expected = grid->data;
+  // maps may have more data than their size
+  grid->data.resize(grid->data.size() + 17, 100);
+  robots[0].map = grid;
+
+  std::string path = snapshotPath();
+  ASSERT_TRUE(map_merge::saveSnapshot(path, robots));
+  std::vector<map_merge::RobotSnapshot> loaded;
+  ASSERT_TRUE(map_merge::loadSnapshot(path, loaded));
+  std::remove(path.c_str());
+  ASSERT_EQ(loaded.size(), 1u);
+  EXPECT_TRUE(loaded[0].map->data == expected);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,175 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2015-2016, Jiri Horner.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Jiri Horner nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *********************************************************************/
+
+#include <gtest/gtest.h>
+#include <map_merge/tiled_grid.h>
+#include <random>
+
+// random grid with values of occupancy grid
+static nav_msgs::OccupancyGridPtr randomGrid(std::mt19937& rng,
+                                             unsigned int width,
+                                             unsigned int height)
+{
+  std::uniform_int_distribution<int> value(-1, 100);
+  nav_msgs::OccupancyGridPtr grid(new nav_msgs::OccupancyGrid());
+  grid->info.width = width;
+  grid->info.height = height;
+  grid->data.resize(size_t(width) * height);
+  for (auto& cell : grid->data) {
+    cell = static_cast<int8_t>(value(rng));
+  }
+  return grid;
+}
+
+// applies update to contiguous grid
+static void applyUpdate(const map_msgs::OccupancyGridUpdate& update,
+                        nav_msgs::OccupancyGrid& grid)
+{
+  for (unsigned int y = 0; y < update.height; ++y) {
+    for (unsigned int x = 0; x < update.width; ++x) {
+      unsigned int grid_x = unsigned(update.x) + x;
+      unsigned int grid_y = unsigned(update.y) + y;
+      if (grid_x < grid.info.width && grid_y < grid.info.height) {
+        grid.data[grid_y * grid.info.width + grid_x] =
+            update.data[y * update.width + x];
+      }
+    }
+  }
+}
+
+static map_msgs::OccupancyGridUpdate randomUpdate(std::mt19937& rng, int x,
+                                                  int y, unsigned int width,
+                                                  unsigned int height)
+{
+  std::uniform_int_distribution<int> value(-1, 100);
+  map_msgs::OccupancyGridUpdate update;
+  update.x = x;
+  update.y = y;
+  update.width = width;
+  update.height = height;
+  update.data.resize(size_t(width) * height);
+  for (auto& cell : update.data) {
+    cell = static_cast<int8_t>(value(rng));
+  }
+  return update;
+}
+
+TEST(TiledGrid, fullMapNotCopied)
+{
+  std::mt19937 rng(1);
+  auto map = randomGrid(rng, 300, 200);
+  map_merge::TiledGrid grid;
+  EXPECT_TRUE(grid.empty());
+  grid.reset(map);
+  EXPECT_FALSE(grid.empty());
+  EXPECT_FALSE(grid.modified());
+  EXPECT_EQ(grid.base(), map);
+  EXPECT_EQ(grid.copy()->data, map->data);
+}
+
+TEST(TiledGrid, updates)
+{
+  std::mt19937 rng(2);
+  auto map = randomGrid(rng, 300, 200);
+  nav_msgs::OccupancyGrid expected = *map;
+  map_merge::TiledGrid grid;
+  grid.reset(map);
+
+  // crossing tiles
+  auto update = randomUpdate(rng, 50, 60, 100, 30);
+  EXPECT_EQ(grid.update(update), cv::Rect(50, 60, 100, 30));
+  applyUpdate(update, expected);
+  // partially outside of the grid
+  update = randomUpdate(rng, 250, 180, 100, 30);
+  EXPECT_EQ(grid.update(update), cv::Rect(250, 180, 50, 20));
+  applyUpdate(update, expected);
+  // completely outside of the grid
+  update = randomUpdate(rng, 300, 0, 10, 10);
+  EXPECT_EQ(grid.update(update).area(), 0);
+
+  EXPECT_TRUE(grid.modified());
+  EXPECT_EQ(grid.copy()->data, expected.data);
+  // full map message is never modified
+  EXPECT_NE(map->data, expected.data);
+}
+
+TEST(TiledGrid, snapshotsAreConsistent)
+{
+  std::mt19937 rng(3);
+  auto map = randomGrid(rng, 257, 130);
+  nav_msgs::OccupancyGrid expected = *map;
+  map_merge::TiledGrid grid;
+  grid.reset(map);
+
+  std::vector<std::pair<map_merge::TiledGrid, nav_msgs::OccupancyGrid>>
+      snapshots;
+  std::uniform_int_distribution<int> x(0, 256), y(0, 129), size(1, 80);
+  for (size_t i = 0; i < 20; ++i) {
+    auto update = randomUpdate(rng, x(rng), y(rng), unsigned(size(rng)),
+                               unsigned(size(rng)));
+    grid.update(update);
+    applyUpdate(update, expected);
+    snapshots.emplace_back(grid, expected);
+  }
+  // writes after reset must not affect old snapshots either
+  grid.reset(randomGrid(rng, 257, 130));
+  grid.update(randomUpdate(rng, 0, 0, 257, 130));
+
+  for (const auto& snapshot : snapshots) {
+    EXPECT_EQ(snapshot.first.copy()->data, snapshot.second.data);
+  }
+}
+
+TEST(TiledGrid, copyRegion)
+{
+  std::mt19937 rng(4);
+  auto map = randomGrid(rng, 200, 200);
+  map_merge::TiledGrid grid;
+  grid.reset(map);
+  auto contiguous = grid.copy();
+
+  auto update = randomUpdate(rng, 60, 10, 90, 120);
+  cv::Rect region = grid.update(update);
+  grid.copyTo(region, *contiguous);
+  applyUpdate(update, *map);
+  EXPECT_EQ(contiguous->data, map->data);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}